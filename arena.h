@@ -0,0 +1,81 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include<stdlib.h>
+#include<stdint.h>
+
+// Growable byte storage for labels, constants and op saves.
+// Entries are addressed by offset so they stay valid when the arena moves.
+
+#define ARENA_START_SIZE	4096
+#define ARENA_MAX_SIZE		0xfffffff0	// offsets are kept in uint32_t
+
+typedef struct Arena
+{
+	uint8_t*	data;
+	uint32_t	size;		// bytes in use
+	uint32_t	capacity;	// bytes allocated
+}Arena;
+
+// make room for bytes more, returns 0 if out of memory
+int arena_reserve(Arena *arena,uint32_t bytes)
+{
+	if( (uint64_t)arena->size + bytes <= arena->capacity )
+	{
+		return 1;
+	}
+	if( (uint64_t)arena->size + bytes > ARENA_MAX_SIZE )
+	{
+		return 0;
+	}
+	uint64_t capacity = arena->capacity ? arena->capacity : ARENA_START_SIZE;
+	while(capacity < (uint64_t)arena->size + bytes)
+	{
+		capacity = capacity * 2; // grow geometrically
+	}
+	if(capacity > ARENA_MAX_SIZE)
+	{
+		capacity = ARENA_MAX_SIZE;
+	}
+	uint8_t *data = realloc(arena->data,capacity);
+	if(data == NULL)
+	{
+		return 0;
+	}
+	arena->data = data;
+	arena->capacity = capacity;
+	return 1;
+}
+
+void arena_reset(Arena *arena)
+{
+	arena->size = 0;
+}
+
+void arena_free(Arena *arena)
+{
+	free(arena->data);
+	arena->data = NULL;
+	arena->size = 0;
+	arena->capacity = 0;
+}
+
+#endif
@@ -0,0 +1,142 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BASM_H_
+#define BASM_H_
+
+// Library interface, build basm_rv.c with -DBASM_LIBRARY to leave out main().
+
+#include<stdio.h>
+#include<stddef.h>
+#include<stdint.h>
+
+#define BASM_ERROR_SIZE		128
+
+typedef struct basm_output
+{
+	uint8_t*	data;		// the flat binary, release with basm_output_free()
+	size_t		size;
+	int			error_line;	// line of the error starting at 1, 0 if there is no line
+	char		error[BASM_ERROR_SIZE];	// empty when assembled with no errors
+	char*		messages;	// with BASM_KEEP_MESSAGES the warnings as they would have been printed, NULL if none
+}basm_output;
+
+// Filled in by basm_assemble_stats(), times are in seconds.
+typedef struct basm_stats
+{
+	double		total_time;
+	double		tokenize_time;	// parsing not counted in the times below
+	double		op_lookup_time;	// search_op()
+	double		label_time;		// label and const tables
+	double		encode_time;	// encoding ops and adding them to the image
+	double		fixup_time;		// file_finish()
+	double		write_time;		// set by the caller that writes the image
+	uint64_t	lines;
+	uint64_t	instructions;	// ops written, whatever their size, data lines are not counted
+	uint64_t	labels;
+	uint64_t	consts;
+	uint64_t	forward_refs;	// ops saved for file_finish()
+	uint64_t	label_probes;	// label hash slots looked at
+	uint64_t	const_steps;	// const entries looked at
+	uint64_t	bytes_written;
+}basm_stats;
+
+// Assembles len bytes of source text. Returns 0 on success, -1 on an error
+// described by out->error. Safe to call from several threads at once.
+int basm_assemble(const char *src,size_t len,basm_output *out);
+// Same as basm_assemble() but a large source is split over up to threads threads.
+int basm_assemble_threads(const char *src,size_t len,int threads,basm_output *out);
+// Same as basm_assemble() and fills in stats, the timers slow it down.
+int basm_assemble_stats(const char *src,size_t len,basm_output *out,basm_stats *stats);
+// Writes stats as one line of JSON.
+void basm_stats_json(const basm_stats *stats,FILE *file);
+void basm_output_free(basm_output *out);
+
+#define BASM_ELF_RELOCATABLE	0x1	// ET_REL, branches and jumps to missing labels get relocations
+#define BASM_ELF_EXECUTABLE		0x2	// ET_EXEC, loaded at 0x10000 and started at the first byte
+#define BASM_COMPRESS			0x4	// RV64C, ops that have a 16 bit form are written in it
+#define BASM_RELAX				0x8	// branches and jumps take the smallest form that reaches their label
+#define BASM_PIPELINE			0x10	// basm_assemble_stream() reads and writes on threads of their own
+#define BASM_NO_DATA_FILES		0x20	// $f is an error, for sources from someone who may not read local files
+#define BASM_KEEP_MESSAGES		0x40	// warnings go in out->messages instead of being printed
+// With BASM_RELAX, lets a branch or an rd x0 jump past the 1 MiB reach of a
+// JAL go through AUIPC + JALR on x<reg>, which is clobbered. Without it they
+// are a range error.
+#define BASM_RELAX_SCRATCH(reg)	((reg) << BASM_RELAX_SCRATCH_SHIFT)
+#define BASM_RELAX_SCRATCH_SHIFT	8
+#define BASM_RELAX_SCRATCH_MASK		0x1f00
+
+// Same as basm_assemble_stats() with flags, stats may be NULL. Only
+// BASM_COMPRESS, BASM_RELAX, BASM_RELAX_SCRATCH, BASM_NO_DATA_FILES and
+// BASM_KEEP_MESSAGES are used here.
+int basm_assemble_flags(const char *src,size_t len,int flags,basm_output *out,basm_stats *stats);
+// Same as basm_assemble_flags() but $f paths that are not absolute are read
+// from dir, the directory the source came from, instead of the current one.
+int basm_assemble_dir(const char *src,size_t len,int flags,const char *dir,basm_output *out,basm_stats *stats);
+// Same as basm_assemble() but streams the result to file as an ELF64 RISC-V
+// file with a symbol for every label. flags is BASM_ELF_RELOCATABLE or
+// BASM_ELF_EXECUTABLE, BASM_COMPRESS, BASM_RELAX, BASM_RELAX_SCRATCH and
+// BASM_NO_DATA_FILES may be or'd in.
+// out->size is the number of bytes written, out->data is not set.
+int basm_assemble_elf(const char *src,size_t len,int flags,FILE *file,basm_output *out);
+// Reads the source from input as it arrives and writes the flat binary to
+// output, holding back only the part of it that forward references point
+// into. BASM_COMPRESS, BASM_PIPELINE and BASM_NO_DATA_FILES may be set in flags. out->size is
+// the number of bytes written, out->data is not set. On an error what was
+// written so far is left in output.
+int basm_assemble_stream(FILE *input,FILE *output,int flags,basm_output *out);
+
+// Holds the code every region of the last source assembled to, a region being
+// the lines from one label to the next few. Release with basm_cache_free().
+typedef struct basm_cache basm_cache;
+basm_cache* basm_cache_new(void);
+void basm_cache_free(basm_cache *cache);
+// Same as basm_assemble() but only the regions of src that changed since the
+// last call with cache are parsed again. Calls sharing a cache must not run
+// at the same time.
+int basm_assemble_cached(basm_cache *cache,const char *src,size_t len,basm_output *out);
+// Same as basm_assemble_cached() with BASM_NO_DATA_FILES and BASM_KEEP_MESSAGES
+// taken from flags. With BASM_COMPRESS or BASM_RELAX the cache is not used.
+int basm_assemble_cached_flags(basm_cache *cache,const char *src,size_t len,int flags,basm_output *out);
+
+// Keeps the tables and buffers of one assembly for the next, for a caller that
+// assembles many small sources one after another. Release with basm_session_free().
+typedef struct basm_session basm_session;
+basm_session* basm_session_new(void);
+void basm_session_free(basm_session *session);
+// Same as basm_assemble_flags() with no stats, but out->data and out->messages
+// belong to session and are only valid until its next call, do not
+// basm_output_free() them.
+int basm_assemble_session(basm_session *session,const char *src,size_t len,int flags,basm_output *out);
+
+// Client side of basm_rv --serve. Returns a connection to the daemon listening
+// on socket_path or -1, close it with close(). One connection can be used for
+// any number of sources but only by one thread at a time.
+int basm_connect(const char *socket_path);
+// Same as basm_assemble_flags() with no stats, done by the daemon at the other
+// end of connection. BASM_COMPRESS, BASM_RELAX, BASM_RELAX_SCRATCH and
+// BASM_KEEP_MESSAGES may be set in flags, the daemon's warnings are printed
+// here or kept in out->messages. The daemon refuses $f.
+int basm_assemble_remote(int connection,const char *src,size_t len,int flags,basm_output *out);
+// Same as basm_assemble_remote() but path names the file src was read from.
+// The daemon keeps a basm_cache for each path, so an edited file only has
+// the regions that changed parsed again. With BASM_COMPRESS or BASM_RELAX set
+// no cache is kept.
+int basm_assemble_remote_cached(int connection,const char *path,const char *src,size_t len,int flags,basm_output *out);
+
+#endif
@@ -19,22 +19,42 @@
 #include<stdio.h>
 #include<stdlib.h>//
 #include<stdint.h>
+#include<string.h>
+#include<setjmp.h>
+#include<pthread.h>
 
+#include"basm.h"
 #include"encoder.h"
 #include"io.h"
+#include"arena.h"
 #include"op_types.h"
+#include"stats.h"
+#include"scan.h"
+#include"elf.h"
+#include"ring.h"
+#include"serve.h"
+#ifndef BASM_LIBRARY
+#include"batch.h"
+#endif
 
 
 #define	TRUE	1
 #define FALSE	0
 
 #define OP_CODE_SIZE		4
-#define MAX_TOKEN_SIZE 		32
+#define MAX_NAME_SIZE 		255	// label and const entries keep the name length in one byte
 #define MAX_HEX_LENGTH		8
+#define MAX_PATH_SIZE		4096
 //#define MAX_LINE_LENGTH		128
-#define MAX_FULL_LABELS		2600
-#define LABEL_SLOT			MAX_TOKEN_SIZE + 5 // the 5 is, one byte header + 4 bytes code position
-#define LABEL_BUFFER_MAX	LABEL_SLOT*MAX_FULL_LABELS
+#define LABEL_HEADER		5	// one byte header + 4 bytes code position, name follows
+#define LABEL_INDEX_START	1024	// hash slots, must be a power of two
+#define CONST_HEADER		9	// one byte header + 8 bytes value, name follows
+#define CONST_INDEX_START	256		// hash slots, must be a power of two
+#define MAX_CONST_HEX_LENGTH	16	// digits of a number in a const expression
+#define MAX_CONST_DEPTH		32	// brackets and minus signs a const expression may nest
+#define LABEL_UNDEFINED		0xffffffff // address of a label that has been used but not reached yet
+#define CHUNK_MAX			64		// most threads one source is split over
+#define CHUNK_MIN_SIZE		(1<<16)	// smaller sources are not worth splitting
 
 
 #define LINE_END 			10
@@ -51,6 +71,16 @@
 #define L_SQUARE_BRACKET	91  // [
 #define R_SQUARE_BRACKET	93  // ]
 #define GREATER_THAN		62	// >
+#define LESS_THAN			60	// <
+#define PLUS				43	// +
+#define AMPERSAND			38	// &
+#define PIPE				124	// |
+#define L_BRACKET			40	// (
+#define R_BRACKET			41	// )
+#define DATA_BYTES			98	// b  $b [..] bytes
+#define DATA_HALVES			104	// h  $h [..] 16 bit halfwords
+#define DATA_WORDS			119	// w  $w [..] 32 bit words
+#define DATA_FILE			102	// f  $f [..] raw file
 
 #define END_OF_FILE			0
 #define RECV_CHAR			1
@@ -63,295 +93,589 @@
 #define CHAR				uint8_t
 #define CHAR_PTR			uint8_t*
 
-// Globals
-CHAR 		label_buffer[LABEL_BUFFER_MAX];
-uint32_t	label_buffer_position; // Todo - Change this to a local var.
-
-CHAR 		const_buffer[LABEL_BUFFER_MAX];
-uint32_t	const_buffer_position;
-
-Op_Saves	op_saves[LABEL_BUFFER_MAX * 2];
-uint32_t	op_saves_pos = 0;
-
-Op_Name 	op_name[NUMBER_OF_OPS];	// defined in op_types.h
-Known_Prams	op_const[NUMBER_OF_OPS];
+// All assembler state lives in the context so several sources can be
+// assembled in one process, every parser function gets it as ctx.
+typedef struct Label_Index
+{
+	uint32_t	hash;
+	uint32_t	slot;	// label_buffer position + 1, zero is an empty entry
+}Label_Index;
 
-CHAR 		tmp_token_buffer[MAX_TOKEN_SIZE];
-int32_t 	tmp_token_buffer_length;
-CHAR 		new_char = SPACE;
-uint32_t	source_line_number =0 ;
-uint32_t	output_code_position = 0;
-//uint32_t	in_white_space;
-uint32_t	reached_end_of_file = FALSE;
+// Ops that use a label not reached yet. One structure of arrays per op type
+// so file_finish() can resolve each type in its own straight loop.
+typedef struct Fixups
+{
+	Arena		op_pos;		// uint32_t code position of the op
+	Arena		label_pos;	// uint32_t label_buffer position of the label address
+	Arena		code;		// uint32_t op encoded with a zero offset
+	Arena		line;		// uint32_t source line of the op, only kept when relaxing or streaming
+	uint32_t	count;
+}Fixups;
+
+// An op that uses a label when relaxing. Positions are in the image as it
+// was parsed, where each of these ops is a 4 byte placeholder.
+typedef struct Relax_Op
+{
+	uint32_t	op_pos;
+	uint32_t	label_addr;		// LABEL_UNDEFINED for an ELF relocation
+	uint32_t	label_index;	// relax ops before the label
+	uint32_t	code;			// encoded with a zero offset
+	uint32_t	fixup;			// index in fixups[type]
+	uint32_t	line;			// source line, for a range error
+	uint8_t		type;
+	uint8_t		size;			// bytes it takes now, only ever grows
+	uint16_t	pad;
+}Relax_Op;
+
+// A warning kept instead of printed, the region cache prints a region's
+// warnings again each time it is used
+typedef struct Warning
+{
+	char*		message;
+	uint32_t	line;
+}Warning;
 
+typedef struct Basm_Context
+{
+	const uint8_t*	source_ptr;		// next char to read
+	const uint8_t*	source_end;
+
+	Arena 		label_buffer;
+	uint32_t	label_buffer_position; // Todo - Change this to a local var.
+	uint32_t	label_count;
+	Label_Index*	label_index;
+	uint32_t	label_index_size;
+
+	Arena 		const_buffer;
+	uint32_t	const_buffer_position;
+	uint32_t	const_count;
+	Label_Index*	const_index;	// slots point into const_buffer
+	uint32_t	const_index_size;
+
+	Fixups		fixups[NUMBER_OF_TYPES];	// indexed by op_type
+	Arena		fixup_offsets;	// int32_t scratch used by file_finish()
+
+	Arena		output_code;	// the binary image
+	uint32_t	output_flushed;	// bytes of the image written out and dropped from output_code
+	int			streamed;		// the image is written out as it goes, see run_stream()
+	uint32_t	streamed_out_of_range;	// ops patched early by resolve_reached_fixups(), warned about by file_finish()
+	uint32_t	text_end;		// end of the last op, an ELF executable starts .data here
+	int			keep_undefined;	// labels never reached are left for ELF relocations
+	int			compress;		// RVC, ops with a 16 bit form take C_OP_CODE_SIZE bytes
+	int			relax;			// ops that use a label are sized by relax_finish()
+	int			relax_scratch;	// register far jumps may clobber, 0 for none
+	Arena		relax_ops;		// Relax_Op scratch used by relax_finish()
+	int			keep_warnings;	// warnings go in warnings instead of being printed
+	int			keep_messages;	// warnings go in messages instead of being printed, see context_print()
+	Arena		messages;		// text handed to out->messages, kept NUL terminated
+	const char*	data_dir;		// $f paths that are not absolute are read from here, NULL for the current directory
+	int			no_data_files;	// $f is an error, set for sources sent to the daemon
+	Arena		warnings;		// Warning entries
+
+	const CHAR*	token;			// last name read, a slice of the source, not a copy
+	int32_t 	token_length;
+	int32_t		hex_number;		// set by load_hex_to_tmp()
+	CHAR 		new_char;
+	uint32_t	source_line_number;
+	uint32_t	output_code_position;
+	uint32_t	reached_end_of_file;
+
+	jmp_buf		error_jump;	// assemble_error() returns to basm_assemble() through this
+	basm_output*	out;
+	basm_stats*		stats;		// NULL unless basm_assemble_stats() was called
+	double			stats_mark;
+}Basm_Context;
+
+_Noreturn void assemble_error(Basm_Context *ctx,char *error,int source_code_number);
+uint32_t context_alloc(Basm_Context *ctx,Arena *arena,uint32_t bytes);
 //
-void next_char();			 // %50 - done
-void clear_white_space();	 // %100 - done
-void skip_line();			 // %100 - done
+static inline void next_char(Basm_Context *ctx);	 // %100 - done
+void clear_white_space(Basm_Context *ctx);	 // %100 - done
+void skip_line(Basm_Context *ctx);			 // %100 - done
 
-int compare_buffer(CHAR_PTR a,CHAR_PTR b,int size);			 
-void copy_buffer(void *src,void *dst,int size);
+int compare_buffer(const CHAR *a,const CHAR *b,int size);			 
+void copy_buffer(const void *src,void *dst,int size);
+uint32_t hash_name(const CHAR *name,int size);
 //
 int check_white_space(CHAR check);
 int check_numbers(CHAR check);
-int check_upper_case(CHAR check);
-int check_lower_case(CHAR check);
 int check_hex(CHAR check);
-int check_AF(CHAR check);
-int check_af(CHAR check);
 //
-uint32_t check_12bit(int32_t num)
+// print_error() for a message about the source, with keep_messages set it is
+// added to messages the way print_error() would have written it
+void context_print(Basm_Context *ctx,char *message,int line)
+{
+	if(!ctx->keep_messages)
+	{
+		print_error(message,line);
+		return;
+	}
+	int length = (line >= 0) ? snprintf(NULL,0,"%s - on line %i \n",message,line+1) : snprintf(NULL,0,"%s",message);
+	uint32_t offset = context_alloc(ctx,&ctx->messages,length + 1);
+	if(line >= 0)
+	{
+		snprintf((char*)&ctx->messages.data[offset],length + 1,"%s - on line %i \n",message,line+1);
+	}
+	else
+	{
+		snprintf((char*)&ctx->messages.data[offset],length + 1,"%s",message);
+	}
+	ctx->messages.size--;	// the NUL is written over by the next one
+}
+
+// prints a warning on the current line, or keeps it when keep_warnings is set
+void assemble_warning(Basm_Context *ctx,char *message)
+{
+	if(ctx->keep_warnings)
+	{
+		Warning warning = { message, ctx->source_line_number };
+		uint32_t offset = context_alloc(ctx,&ctx->warnings,sizeof(Warning));
+		copy_buffer(&warning,&ctx->warnings.data[offset],sizeof(Warning));
+		return;
+	}
+	context_print(ctx,message,ctx->source_line_number);
+}
+
+uint32_t check_12bit(Basm_Context *ctx,int32_t num)
 {
 	if( (num>SIGNED_12_BIT_MAX) || (num < SIGNED_12_BIT_MIN) )
 	{
-		print_error("Error Offset out of scope",source_line_number);
+		assemble_warning(ctx,"Error Offset out of scope");
 	}
 	return num;	
 }
-uint32_t check_20bit(int32_t num)
+uint32_t check_20bit(Basm_Context *ctx,int32_t num)
 {
 	if( (num>SIGNED_20_BIT_MAX) || (num < SIGNED_20_BIT_MIN) )
 	{
-		print_error("Error Offset out of scope",source_line_number);
+		assemble_warning(ctx,"Error Offset out of scope");
 	}
 	return num;	
 }
 
 
-void start_parser();
-void parser_start_new_line();
-
-void parse_Label();			 // %90 - done -needs error code
-void parse_Const();			 // %0
-void parse_Data();			 // %0
-void parse_OP();			 // %0
-	void parse_type_r(uint8_t id);// rd, rs1 ,rs2
-	void parse_type_i(uint8_t id);
-	void parse_type_b(uint8_t id);
-	void parse_type_s(uint8_t id);
-	void parse_type_j(uint8_t id);
-	void parse_type_u(uint8_t id);
-
-uint8_t get_reg();
-void load_name_to_tmp();	// %100
-void load_op_name_to_tmp(); // %100
-void load_hex_to_tmp();
-void find_end_of_line();	// %100
-void add_const_name();
-void add_const_hex();
-int32_t convert_txt_to_hex();
-void binary_write_data(uint32_t data);
-void add_label();			 // %100
-int32_t have_label(int32_t *l_number);
-void get_label();			 // %0
-int32_t get_const();
-
-uint8_t compare_ops(int a,int b);
-uint8_t search_op();
-
-void search_label_buffer();	 // %0 
-
-void save_op(); 			 // %0
-
-void file_finish(); // %0
-
-void parser_start_new_line()
+void start_parser(Basm_Context *ctx);
+void parser_start_new_line(Basm_Context *ctx);
+
+void parse_Label(Basm_Context *ctx);			 // %90 - done -needs error code
+void parse_Const(Basm_Context *ctx);			 // %0
+void parse_Data(Basm_Context *ctx);			 // %0
+	void parse_data_list(Basm_Context *ctx,uint32_t unit);
+	void parse_data_file(Basm_Context *ctx);
+void parse_OP(Basm_Context *ctx);			 // %0
+	void parse_type_r(Basm_Context *ctx,uint8_t id);// rd, rs1 ,rs2
+	void parse_type_i(Basm_Context *ctx,uint8_t id);
+	void parse_type_b(Basm_Context *ctx,uint8_t id);
+	void parse_type_s(Basm_Context *ctx,uint8_t id);
+	void parse_type_j(Basm_Context *ctx,uint8_t id);
+	void parse_type_u(Basm_Context *ctx,uint8_t id);
+
+uint8_t get_reg(Basm_Context *ctx);
+void load_name_token(Basm_Context *ctx);	// %100
+void load_op_name_token(Basm_Context *ctx); // %100
+void load_hex_to_tmp(Basm_Context *ctx);
+void find_end_of_line(Basm_Context *ctx);	// %100
+int32_t convert_txt_to_hex(Basm_Context *ctx);
+void binary_write_data(Basm_Context *ctx,uint32_t data);
+void binary_write_op(Basm_Context *ctx,uint32_t code);
+uint32_t binary_write_bytes(Basm_Context *ctx,uint32_t bytes);
+void binary_write_padding(Basm_Context *ctx);
+void patch_code(Basm_Context *ctx,uint32_t pos,uint32_t data);
+void add_label(Basm_Context *ctx);			 // %100
+int32_t have_label(Basm_Context *ctx,int32_t *l_number);
+int find_label(Basm_Context *ctx,uint32_t hash);
+void new_label(Basm_Context *ctx,uint32_t hash,uint32_t address);
+void grow_label_index(Basm_Context *ctx);
+void get_label(Basm_Context *ctx);			 // %0
+int32_t get_const(Basm_Context *ctx);
+int find_const(Basm_Context *ctx,uint32_t hash);
+void new_const(Basm_Context *ctx,const CHAR *name,int32_t length,uint32_t hash,int64_t value);
+int64_t const_expression(Basm_Context *ctx,int depth);
+
+uint8_t search_op(Basm_Context *ctx);
+
+void search_label_buffer(Basm_Context *ctx);	 // %0 
+
+void save_op(Basm_Context *ctx,uint8_t id,uint8_t rd,uint8_t rs1,uint8_t rs2,uint32_t label_pos);
+void add_fixup(Basm_Context *ctx,uint8_t type,uint32_t op_pos,uint32_t label_pos,uint32_t code);
+
+void file_finish(Basm_Context *ctx); // %0
+void relax_finish(Basm_Context *ctx);
+
+int assemble_elf_dir(const char *src,size_t len,int flags,const char *dir,FILE *file,basm_output *out);
+int assemble_threads_dir(const char *src,size_t len,int threads,const char *dir,basm_output *out);
+int assemble_stream_dir(FILE *input,FILE *output,int flags,const char *dir,basm_output *out);
+
+void parser_start_new_line(Basm_Context *ctx)
 {
-	clear_white_space();
-	switch(new_char)
+	clear_white_space(ctx);
+	switch(ctx->new_char)
 	{
 		case LINE_END:
-			source_line_number++;
+			ctx->source_line_number++;
 			break;
 			
 		case COMMENT:
-			skip_line(); // skip the rest of char, return when reach LINE_END
-			source_line_number++;
+			skip_line(ctx); // skip the rest of char, return when reach LINE_END
+			ctx->source_line_number++;
 			break;
 
 		case COLON:
-			parse_Label();
-			source_line_number++;
+			parse_Label(ctx);
+			ctx->source_line_number++;
 			break;
 
 		case AT_SIGN:
-			parse_Const();
-			source_line_number++;
+			parse_Const(ctx);
+			ctx->source_line_number++;
 			break;
 
 		case DOLLAR_SIGN:
-			parse_Data();
-			source_line_number++;
+			parse_Data(ctx);
+			ctx->source_line_number++;
 			break;
 		
 		case 0:
-			//file_finish();
+			//file_finish(ctx);
 			//printf("FILE END");
 			break;
 		
 
 		default:
-			parse_OP();
-			source_line_number++;
+			parse_OP(ctx);
+			ctx->text_end = ctx->output_code_position;
+			ctx->source_line_number++;
 			break;
 			
 	}
 }
 
-void clear_white_space()
+// The source is in memory so the scanners below walk source_ptr directly,
+// new_char always holds the char just before source_ptr.
+void clear_white_space(Basm_Context *ctx)
 {
-	 
-	next_char();
-
-	while( check_white_space(new_char) )
-	{
-		next_char();
-	}
+	ctx->source_ptr = scan_blank(ctx->source_ptr,ctx->source_end);
+	next_char(ctx);
 
 }
 
-void skip_line()
+void skip_line(Basm_Context *ctx)
 {
 
-	next_char();
-
-	while(new_char!=LINE_END)
+	const uint8_t *line_end = scan_line_end(ctx->source_ptr,ctx->source_end);
+	if(line_end == ctx->source_end)
 	{
-		if(reached_end_of_file)
-		{
-			return;
-		}
-		next_char();
-		//printf(".");
+		ctx->source_ptr = ctx->source_end;
+		ctx->reached_end_of_file = TRUE;
+		ctx->new_char = 0;
+		return;
 	}
+	ctx->source_ptr = line_end + 1;
+	ctx->new_char = LINE_END;
 	
 }
 
-void next_char()
+static inline void next_char(Basm_Context *ctx)
 {
 
-	if(get_char(&new_char) == FALSE)
+	if(ctx->source_ptr < ctx->source_end)
 	{
-		reached_end_of_file = TRUE;
-		new_char = 0;
+		ctx->new_char = *ctx->source_ptr++;
+		return;
 	}
+	ctx->reached_end_of_file = TRUE;
+	ctx->new_char = 0;
 	return;
 }
 
-void parse_Data()			 // %0
+void parse_Data(Basm_Context *ctx)			 // %0
 {
 	// current new_char is '$' ,this move to next none white space
-	clear_white_space(); 
-	if(new_char == L_SQUARE_BRACKET) // hex number
+	clear_white_space(ctx); 
+	if(ctx->new_char == L_SQUARE_BRACKET) // hex number
 	{
 		// load hex number
-		clear_white_space();
-		load_hex_to_tmp();// 
+		clear_white_space(ctx);
+		load_hex_to_tmp(ctx);// 
 
-		if(new_char != R_SQUARE_BRACKET) // check for closing bracket ] 
+		if(ctx->new_char != R_SQUARE_BRACKET) // check for closing bracket ] 
 		{
 			// error out "Const syntax incorrect on line" source_line_number
-			print_error("Const Syntax Incorrect",source_line_number);
-			exit(-1);
+			assemble_error(ctx,"Const Syntax Incorrect",ctx->source_line_number);
 		}
 
-		next_char();
-		find_end_of_line();
+		next_char(ctx);
+		find_end_of_line(ctx);
 
-		int32_t number = convert_txt_to_hex();
+		int32_t number = convert_txt_to_hex(ctx);
 		// write number	
-		binary_write_data(number);
+		binary_write_data(ctx,number);
+	}
+	else if(ctx->new_char == DATA_BYTES )
+	{
+		parse_data_list(ctx,1);
+	}
+	else if(ctx->new_char == DATA_HALVES )
+	{
+		parse_data_list(ctx,2);
+	}
+	else if(ctx->new_char == DATA_WORDS )
+	{
+		parse_data_list(ctx,4);
 	}
-	else if(new_char == AT_SIGN ) // get const
+	else if(ctx->new_char == DATA_FILE )
+	{
+		parse_data_file(ctx);
+	}
+	else if(ctx->new_char == AT_SIGN ) // get const
 	{
 		// get const number
-		clear_white_space();
-		load_name_to_tmp();
-		int32_t number = get_const();
+		clear_white_space(ctx);
+		load_name_token(ctx);
+		int32_t number = get_const(ctx);
 
-		//next_char();
-		find_end_of_line();
+		//next_char(ctx);
+		find_end_of_line(ctx);
 		// write number
-		binary_write_data(number);
+		binary_write_data(ctx,number);
 	}
 	else // error
 	{
-		print_error("Const Syntax Incorrect",source_line_number);
-		exit(-1);	
+		assemble_error(ctx,"Const Syntax Incorrect",ctx->source_line_number);	
 	}
 	return;	
 }
 
-void parse_Label()
+// $b [de ad beef], $h [1234 -1], $w [deadbeef 1] - many values on one line,
+// separated by blanks or commas. A $b run is any even number of digits,
+// written in the order they are read. Halfwords and words are little
+// endian. The line is padded with zeros to OP_CODE_SIZE so ops stay aligned.
+void parse_data_list(Basm_Context *ctx,uint32_t unit)
+{
+	clear_white_space(ctx);
+	if(ctx->new_char != L_SQUARE_BRACKET)
+	{
+		assemble_error(ctx,"Data Syntax Incorrect",ctx->source_line_number);
+	}
+	clear_white_space(ctx);
+	while(ctx->new_char != R_SQUARE_BRACKET)
+	{
+		int negative = FALSE;
+		if( (ctx->new_char == MINUS) && (unit > 1) )
+		{
+			negative = TRUE;
+			next_char(ctx);
+		}
+		if( !check_hex(ctx->new_char) )
+		{
+			assemble_error(ctx,"Data Syntax Incorrect",ctx->source_line_number);
+		}
+		const uint8_t *start = ctx->source_ptr - 1;
+		const uint8_t *end = scan_hex(start,ctx->source_end);
+		uint32_t length = end - start;
+		if(unit == 1)
+		{
+			if(length & 1)
+			{
+				assemble_error(ctx,"Error Bytes need two hex digits ",ctx->source_line_number);
+			}
+			uint32_t offset = binary_write_bytes(ctx,length/2);
+			uint8_t *code = &ctx->output_code.data[offset];
+			// eight digits at a time, then what is left in pairs
+			for(;length >= HEX_WORD_DIGITS;length -= HEX_WORD_DIGITS,start += HEX_WORD_DIGITS,code += 4)
+			{
+				uint32_t number = hex_value(start,HEX_WORD_DIGITS,ctx->source_end);
+				code[0] = number >> 24;
+				code[1] = number >> 16;
+				code[2] = number >> 8;
+				code[3] = number;
+			}
+			for(;length;length -= 2,start += 2,code++)
+			{
+				*code = hex_value(start,2,ctx->source_end);
+			}
+		}
+		else
+		{
+			if(length > unit*2)
+			{
+				assemble_error(ctx," Number is too long",ctx->source_line_number);
+			}
+			uint32_t number = hex_value(start,length,ctx->source_end);
+			number = negative ? -number : number;
+			uint32_t offset = binary_write_bytes(ctx,unit);
+			uint8_t *code = &ctx->output_code.data[offset];
+			// little endian whatever the host is
+			for(uint32_t i=0;i<unit;i++)
+			{
+				code[i] = number >> (i*8);
+			}
+		}
+		ctx->source_ptr = end;
+		next_char(ctx);
+		if( check_white_space(ctx->new_char) )
+		{
+			clear_white_space(ctx);
+		}
+		if(ctx->new_char == COMMA)
+		{
+			clear_white_space(ctx);
+		}
+	}
+	binary_write_padding(ctx);
+	next_char(ctx);
+	find_end_of_line(ctx);
+}
+
+// $f [file.bin] - the file is read straight into the image, then padded like $b.
+// A relative path is from the directory of the source when it came from a file.
+void parse_data_file(Basm_Context *ctx)
+{
+	char path[MAX_PATH_SIZE];
+	clear_white_space(ctx);
+	if(ctx->new_char != L_SQUARE_BRACKET)
+	{
+		assemble_error(ctx,"Data Syntax Incorrect",ctx->source_line_number);
+	}
+	clear_white_space(ctx);
+	const uint8_t *start = ctx->source_ptr - 1;
+	const uint8_t *bracket = start;
+	while( (bracket < ctx->source_end) && (*bracket != R_SQUARE_BRACKET) && (*bracket != LINE_END) )
+	{
+		bracket++;
+	}
+	if( (bracket == ctx->source_end) || (*bracket != R_SQUARE_BRACKET) || (bracket == start) )
+	{
+		assemble_error(ctx,"Data Syntax Incorrect",ctx->source_line_number);
+	}
+	const uint8_t *end = bracket;
+	while( check_white_space(end[-1]) )
+	{
+		end--;
+	}
+	if( (end - start) >= MAX_PATH_SIZE )
+	{
+		assemble_error(ctx," Name is too long",ctx->source_line_number);
+	}
+	if(ctx->no_data_files)
+	{
+		assemble_error(ctx,"Error $f is not allowed here ",ctx->source_line_number);
+	}
+	// a relative path is taken from the directory of the source, not the current one
+	int dir_length = 0;
+	if( (ctx->data_dir != NULL) && (*start != '/') )
+	{
+		dir_length = snprintf(path,MAX_PATH_SIZE,"%s/",ctx->data_dir);
+	}
+	if( (dir_length < 0) || ( (end - start) + dir_length >= MAX_PATH_SIZE ) )
+	{
+		assemble_error(ctx," Name is too long",ctx->source_line_number);
+	}
+	copy_buffer((void*)start,&path[dir_length],end - start);
+	path[dir_length + (end - start)] = 0;
+
+	FILE *file = fopen(path,"rb");
+	if(file == NULL)
+	{
+		assemble_error(ctx,"Error opening data file ",ctx->source_line_number);
+	}
+	long size = -1;
+	if( fseek(file,0,SEEK_END) == 0 )
+	{
+		size = ftell(file);
+		rewind(file);
+	}
+	if( (size < 0) || (size > ARENA_MAX_SIZE) )
+	{
+		fclose(file);
+		assemble_error(ctx,"Error reading data file ",ctx->source_line_number);
+	}
+	uint32_t offset = binary_write_bytes(ctx,size);
+	size_t got = fread(&ctx->output_code.data[offset],1,size,file);
+	fclose(file);
+	if(got != (size_t)size)
+	{
+		assemble_error(ctx,"Error reading data file ",ctx->source_line_number);
+	}
+	binary_write_padding(ctx);
+
+	ctx->source_ptr = bracket + 1;
+	next_char(ctx);
+	find_end_of_line(ctx);
+}
+
+void parse_Label(Basm_Context *ctx)
 {
 	
 	//printf("parse_Label\n"); // Remove
 
-	clear_white_space();
-	load_name_to_tmp();
+	clear_white_space(ctx);
+	load_name_token(ctx);
 	
-	if(new_char != COLON) // check closing Colon 
+	if(ctx->new_char != COLON) // check closing Colon 
 	{
 		// error out "Label syntax incorrect on line" source_line_number
-		print_error(" Label Syntax Incorrect",source_line_number);
-		exit(-1);
+		assemble_error(ctx," Label Syntax Incorrect",ctx->source_line_number);
 
 	}
 
-	add_label();
+	add_label(ctx);
 	// DEBUG REMOVE LATER -----------------
 	//printf("\n");
-	//print_buffer(tmp_token_buffer,tmp_token_buffer_length);
-	//printf(" at buffer pointer %i",label_buffer_position);
+	//print_buffer(ctx->token,ctx->token_length);
+	//printf(" at buffer pointer %i",ctx->label_buffer_position);
 	//printf("\n");
 	
 	
 
-	next_char();	
-	find_end_of_line(); // ignore comments and find end of line.
+	next_char(ctx);	
+	find_end_of_line(ctx); // ignore comments and find end of line.
 	return;
 }
 
 
-void parse_Const()
+void parse_Const(Basm_Context *ctx)
 {
 	
 	//printf("parse_Const\n"); // Remove
 
-	clear_white_space();
-	load_name_to_tmp();
+	clear_white_space(ctx);
+	load_name_token(ctx);
 
-	add_const_name();// 
+	// the name stays in the source while the expression reads other names
+	const CHAR *name = ctx->token;
+	int32_t length = ctx->token_length;
+	uint32_t hash = hash_name(name,length);
+	if( find_const(ctx,hash) )
+	{
+		assemble_error(ctx,"Duplicate Const used ",ctx->source_line_number);
+	}
 
-	if(new_char != L_SQUARE_BRACKET) // check for opening bracket [
+	if(ctx->new_char != L_SQUARE_BRACKET) // check for opening bracket [
 	{
 		// error out "Const syntax incorrect on line" source_line_number
-		print_error("Const Syntax Incorrect",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Const Syntax Incorrect",ctx->source_line_number);
 
 	}
-	clear_white_space();
-	load_hex_to_tmp();// 
+	clear_white_space(ctx);
+	int64_t number = const_expression(ctx,0);
 
-	if(new_char != R_SQUARE_BRACKET) // check for closing bracket ] 
+	if(ctx->new_char != R_SQUARE_BRACKET) // check for closing bracket ] 
 	{
 		// error out "Const syntax incorrect on line" source_line_number
-		print_error("Const Syntax Incorrect",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Const Syntax Incorrect",ctx->source_line_number);
 
 	}
 
-	
-
-	add_const_hex();
+	new_const(ctx,name,length,hash,number);
 
-	next_char();
-	find_end_of_line();
+	next_char(ctx);
+	find_end_of_line(ctx);
 	return;
 
 }
 
-void parse_OP()
+void parse_OP(Basm_Context *ctx)
 {
 	// remove later
 	//print_error("OP is not written yet\n",-1);
@@ -361,1157 +685,3468 @@ void parse_OP()
 	//printf("parse_OP\n"); // Remove
 
 
-	load_op_name_to_tmp();
+	load_op_name_token(ctx);
 
-	uint8_t op_id = search_op();
+	STATS_START(ctx);
+	uint8_t op_id = search_op(ctx);
+	STATS_END(ctx,op_lookup_time);
 
 	// Parse OP type
-	switch(op_const[op_id].op_type)
+	switch(op_info[op_id].op_type)
 	{
 		case TYPE_R:
-			parse_type_r(op_id); // rd, rs1 ,rs2
+			parse_type_r(ctx,op_id); // rd, rs1 ,rs2
 			break;
 		case TYPE_I:
-			parse_type_i(op_id);
+			parse_type_i(ctx,op_id);
 			break;
 		case TYPE_B:
-			parse_type_b(op_id);
+			parse_type_b(ctx,op_id);
 			break;
 		case TYPE_S:
-			parse_type_s(op_id);
+			parse_type_s(ctx,op_id);
 			break;
 		case TYPE_J:
-			parse_type_j(op_id);
+			parse_type_j(ctx,op_id);
 			break;
 		case TYPE_U:
-			parse_type_u(op_id);
+			parse_type_u(ctx,op_id);
 			break;		
 	}
 	
-	find_end_of_line();
-	
-}
-
-uint8_t search_op()
-{
-//CHAR 		tmp_token_buffer[MAX_TOKEN_SIZE];
-//int32_t 	tmp_token_buffer_length;
-	int i;
-	switch(tmp_token_buffer[0])
-	{
-		case LETTER_A:
-			// 1-7
-			return compare_ops(1,7);
-		case LETTER_B:
-			// 8-13		
-			return compare_ops(8,13);
-		case LETTER_C:
-			// 14-19 
-			return compare_ops(14,19);
-		case LETTER_D:
-			// 20-23
-			return compare_ops(20,23);
-		case LETTER_E:
-			// 24-25
-			return compare_ops(24,25);
-		case LETTER_F:
-			// 26-27
-			return compare_ops(26,27);
-		case LETTER_J:
-			// 28-29
-			return compare_ops(28,29);
-		case LETTER_L:
-			// 30-37
-			return compare_ops(30,37);
-		case LETTER_M:
-			// 38-42
-			return compare_ops(38,42);
-		case LETTER_O:
-			// 43-44
-			return compare_ops(43,44);
-		case LETTER_R:
-			//45-48
-			return compare_ops(45,48);
-		case LETTER_S:
-			// 49-70
-			return compare_ops(49,70);
-		case LETTER_X:
-			// 71-72
-			return compare_ops(71,72);
-		default:
-			// error
-			print_error("Error OP Name Error ",source_line_number);
-			exit(-1);
-			
-	}
+	find_end_of_line(ctx);
 	
 }
 
-uint8_t compare_ops(int a,int b) // TODO add global OP Name struct
+uint8_t search_op(Basm_Context *ctx)
 {
-	for(int i = a ; i<=b ;i++)
+	// pack the upper case name into a key and go straight to its hash slot
+	if(ctx->token_length <= OP_MAX_NAME)
 	{
-		if(op_name[i].length == tmp_token_buffer_length)
+		uint64_t key = 0;
+		for(int i = 0; i<ctx->token_length ;i++)
 		{
-			if( compare_buffer(op_name[i].name,tmp_token_buffer,tmp_token_buffer_length) )
-			{
-				return i;
-			}
+			key = key | ( (uint64_t)char_class[ctx->token[i]].upper << (8*i) );
+		}
+		uint8_t id = op_hash_table[OP_HASH(key)];
+		if( (op_key[id] == key) && (op_info[id].op_type != TYPE_NONE) )
+		{
+			return id;
 		}
 	}
 	// error
-	print_error("Error OP not Found ",source_line_number);
-	exit(-1);
+	assemble_error(ctx,"Error OP not Found ",ctx->source_line_number);
 }
 
 // ---------------- Labels Management -------------------------
-void add_flagged_label()  // this function is for labels that have not been reached yet
+// Labels are still stored in label_buffer as [length][address][name] slots,
+// label_index is an open addressing hash table that points into those slots
+// so a define or lookup does not have to rescan the buffer.
+
+// sets label_buffer_position to the label slot if found
+int find_label(Basm_Context *ctx,uint32_t hash)
 {
-	label_buffer_position = 0;
-	while(TRUE)
+	uint32_t mask = ctx->label_index_size - 1;
+	uint32_t i = hash & mask;
+	if(ctx->label_index_size == 0)
 	{
-		
-		// check if search reached last entry
-		if(label_buffer[label_buffer_position] == 0) 
+		return FALSE; // nothing added yet, the index is made by new_label()
+	}
+	STATS_START(ctx);
+	while(ctx->label_index[i].slot != 0)
+	{
+		STATS_COUNT(ctx,label_probes,1);
+		if(ctx->label_index[i].hash == hash)
 		{
-			// not enough memory left  in buffer
-			if( (label_buffer_position + tmp_token_buffer_length + 5)> LABEL_BUFFER_MAX )
+			ctx->label_buffer_position = ctx->label_index[i].slot - 1;
+			// compare label name length and label name
+			if( (ctx->token_length==ctx->label_buffer.data[ctx->label_buffer_position]) &&
+				compare_buffer(&ctx->label_buffer.data[ctx->label_buffer_position+LABEL_HEADER],ctx->token,ctx->token_length) )
 			{
-				//error out
-				print_error("Reached Max ammount of Labels ",source_line_number);
-				exit(-1);
+				STATS_END(ctx,label_time);
+				return TRUE;
 			}
-			// add label, start by anding label size to the header byte
-			label_buffer[label_buffer_position] = tmp_token_buffer_length ;
-			// store flag code in label address
-			uint32_t tmp = 0xffffffff;
-			copy_buffer(&tmp,&label_buffer[label_buffer_position+1],OP_CODE_SIZE);
-			// store label 
-			copy_buffer(tmp_token_buffer,&label_buffer[label_buffer_position+5],tmp_token_buffer_length);
-
-			// zero length , clear
-			tmp_token_buffer_length = 0	;		
-			return;
-   
 		}
-		// next_label
-		label_buffer_position = label_buffer_position + label_buffer[label_buffer_position] + 5;
+		i = (i + 1) & mask;
 	}
+	STATS_END(ctx,label_time);
+	return FALSE;
 }
 
-int32_t have_label(int32_t *l_number)
+// double an index once it is half full and reinsert every entry, the label
+// and const indexes both grow this way
+void grow_index(Basm_Context *ctx,Label_Index **index,uint32_t *size,uint32_t start_size)
 {
-	//
-	uint32_t tmp;
-	label_buffer_position = 0;
-	while(label_buffer[label_buffer_position]!=0)
+	uint32_t old_size = *size;
+	Label_Index *old_index = *index;
+
+	uint32_t new_size = old_size ? old_size*2 : start_size;
+	Label_Index *new_index = calloc(new_size,sizeof(Label_Index));
+	if(new_index == NULL)
+	{
+		assemble_error(ctx,"Error Out of memory ",-1);
+	}
+	for(uint32_t i = 0;i<old_size;i++)
 	{
-		// compare const name length
-		if(tmp_token_buffer_length==label_buffer[label_buffer_position])
+		if(old_index[i].slot != 0)
 		{
-			// compare if const names are equal
-			if(compare_buffer(&label_buffer[label_buffer_position+5],tmp_token_buffer,tmp_token_buffer_length))
+			uint32_t n = old_index[i].hash & (new_size - 1);
+			while(new_index[n].slot != 0)
 			{
-				// copy out number
-				copy_buffer(&label_buffer[label_buffer_position+1],&tmp,OP_CODE_SIZE);
-				if(tmp == 0xffffffff )
-				{
-					// get location to be filled by label
-					*l_number = label_buffer_position+1;
-					return FALSE;
-				}
-				else
-				{
-					*l_number = tmp - (output_code_position);
-					return TRUE;
-				}
-				
+				n = (n + 1) & (new_size - 1);
 			}
+			new_index[n] = old_index[i];
 		}
-		// next_label
-		label_buffer_position = label_buffer_position + label_buffer[label_buffer_position] + 5;	
-		
 	}
-	// Add flagged label
-	if( (label_buffer_position + tmp_token_buffer_length + 5)> LABEL_BUFFER_MAX ) // size check
+	free(old_index);
+	*index = new_index;
+	*size = new_size;
+}
+
+void grow_label_index(Basm_Context *ctx)
+{
+	grow_index(ctx,&ctx->label_index,&ctx->label_index_size,LABEL_INDEX_START);
+}
+
+// adds a label that find_label() did not find
+void new_label(Basm_Context *ctx,uint32_t hash,uint32_t address)
+{
+	STATS_START(ctx);
+	if( (ctx->label_count + 1)*2 > ctx->label_index_size )
 	{
-		//error out
-		print_error("Reached Max ammount of Labels ",source_line_number);
-		exit(-1);
+		grow_label_index(ctx);
 	}
-	// add label, start by anding label size to the header byte
-	label_buffer[label_buffer_position] = tmp_token_buffer_length ;
-
-	// store flag
-	tmp = 0xffffffff;
-	copy_buffer(&tmp,&label_buffer[label_buffer_position+1],OP_CODE_SIZE);
+	ctx->label_buffer_position = context_alloc(ctx,&ctx->label_buffer,ctx->token_length + LABEL_HEADER);
+	// add label, start by adding label size to the header byte
+	ctx->label_buffer.data[ctx->label_buffer_position] = ctx->token_length ;
+	// store code position or flag code in label address
+	copy_buffer(&address,&ctx->label_buffer.data[ctx->label_buffer_position+1],OP_CODE_SIZE);
 	// store label 
-	copy_buffer(tmp_token_buffer,&label_buffer[label_buffer_position+5],tmp_token_buffer_length);
+	copy_buffer(ctx->token,&ctx->label_buffer.data[ctx->label_buffer_position+LABEL_HEADER],ctx->token_length);
+
+	uint32_t i = hash & (ctx->label_index_size - 1);
+	while(ctx->label_index[i].slot != 0)
+	{
+		i = (i + 1) & (ctx->label_index_size - 1);
+	}
+	ctx->label_index[i].hash = hash;
+	ctx->label_index[i].slot = ctx->label_buffer_position + 1;
+	ctx->label_count++;
+	STATS_END(ctx,label_time);
+}
 
+void add_flagged_label(Basm_Context *ctx)  // this function is for labels that have not been reached yet
+{
+	uint32_t hash = hash_name(ctx->token,ctx->token_length);
+	if( !find_label(ctx,hash) )
+	{
+		new_label(ctx,hash,LABEL_UNDEFINED);
+	}
 	// zero length , clear
-	*l_number = (uint32_t) (label_buffer_position+1);
-	tmp_token_buffer_length = 0	;
-	return FALSE;			
-	
+	ctx->token_length = 0	;		
 }
 
-void add_label()
+int32_t have_label(Basm_Context *ctx,int32_t *l_number)
 {
-	// 	0  1  2  3  4  5  6  7  8  9 10 11 12 13 14 15 16 17 18 19 20 21 22 23 24 25 26 27 28
-	//  4  .  .  .  .  .  .  .  .  4  .  .  .  .  .  .  .  .  4  .  .  .  .  .  .  .  .
-	// output_code_position
-	label_buffer_position = 0;
-	while(TRUE)
+	//
+	uint32_t tmp;
+	uint32_t hash = hash_name(ctx->token,ctx->token_length);
+	if( find_label(ctx,hash) )
 	{
-		//printf("add_label\n");
-		// check if search reached last entry
-		if(label_buffer[label_buffer_position] == 0) 
+		// copy out number
+		copy_buffer(&ctx->label_buffer.data[ctx->label_buffer_position+1],&tmp,OP_CODE_SIZE);
+		if( (tmp == LABEL_UNDEFINED) || ctx->relax )
 		{
-			// not enough memory left  in buffer
-			if( (label_buffer_position + tmp_token_buffer_length + 5)> LABEL_BUFFER_MAX )
-			{
-				//error out
-				print_error("Reached Max ammount of Labels ",source_line_number);
-				exit(-1);
-			}
-			// add label, start by anding label size to the header byte
-			label_buffer[label_buffer_position] = tmp_token_buffer_length ;
-			//printf("-- buffer_pointer[%i]=%i --",label_buffer_position,tmp_token_buffer_length);
-			// store code position to go with label
-			copy_buffer(&output_code_position,&label_buffer[label_buffer_position+1],OP_CODE_SIZE);
-			// store label 
-			copy_buffer(tmp_token_buffer,&label_buffer[label_buffer_position+5],tmp_token_buffer_length);
-
-			// zero length , clear
-			//tmp_token_buffer_length = 0	;		
-			return;
-   
+			// get location to be filled by label, when relaxing every label is
+			// filled in by file_finish() as ops before it may still change size
+			*l_number = ctx->label_buffer_position+1;
+			return FALSE;
 		}
 		else
 		{
-			// check if new label equal size of stored label
-			if(tmp_token_buffer_length==label_buffer[label_buffer_position])
-			{
-				// compare if new label = old label
-				if(compare_buffer(&label_buffer[label_buffer_position+5],tmp_token_buffer,tmp_token_buffer_length))
-				{
-
-					// check if old label position is flagged
-					uint32_t tmp; // get value of label
-					copy_buffer(&label_buffer[label_buffer_position+1],&tmp,OP_CODE_SIZE);
-					if(tmp != 0xffffffff )// if not falgged error out
-					{
-						//error out
-						print_error("Duplicate Label used ",source_line_number);
-						exit(-1);
-					}
-					else
-					{
-						// replace flag with code position to go with label
-						copy_buffer(&output_code_position,&label_buffer[label_buffer_position+1],OP_CODE_SIZE);
-						return;
-					}
-				}
-			}
-			// next_label
-			label_buffer_position = label_buffer_position + label_buffer[label_buffer_position] + 5;	
+			*l_number = tmp - (ctx->output_code_position);
+			return TRUE;
 		}
-	}// while
-	
+	}
+	// Add flagged label
+	new_label(ctx,hash,LABEL_UNDEFINED);
+
+	*l_number = (uint32_t) (ctx->label_buffer_position+1);
+	// zero length , clear
+	ctx->token_length = 0	;
+	return FALSE;			
 	
 }
 
-void load_name_to_tmp()
+void add_label(Basm_Context *ctx)
+{
+	// output_code_position
+	uint32_t hash = hash_name(ctx->token,ctx->token_length);
+	if( !find_label(ctx,hash) )
+	{
+		new_label(ctx,hash,ctx->output_code_position);
+		return;
+	}
+	// check if old label position is flagged
+	uint32_t tmp; // get value of label
+	copy_buffer(&ctx->label_buffer.data[ctx->label_buffer_position+1],&tmp,OP_CODE_SIZE);
+	if(tmp != LABEL_UNDEFINED )// if not falgged error out
+	{
+		//error out
+		assemble_error(ctx,"Duplicate Label used ",ctx->source_line_number);
+	}
+	// replace flag with code position to go with label
+	copy_buffer(&ctx->output_code_position,&ctx->label_buffer.data[ctx->label_buffer_position+1],OP_CODE_SIZE);
+}
+
+// The loaders find the whole run with one scan. new_char is the first char
+// of the run, next_char() read it from source_ptr - 1. A name is not copied,
+// ctx->token points at it in the source until the next name is read.
+
+void load_name_token(Basm_Context *ctx)
 {
-	tmp_token_buffer_length = 0;
-	//clear_white_space();
-	while( check_numbers(new_char) || check_upper_case(new_char) || check_lower_case(new_char) )
+	ctx->token_length = 0;
+	//clear_white_space(ctx);
+	if( CHAR_IS(ctx->new_char,CHAR_NAME) )
 	{
-		tmp_token_buffer[tmp_token_buffer_length] = new_char;
-		tmp_token_buffer_length++; // this work for zero indexed.
-		if(tmp_token_buffer_length>MAX_TOKEN_SIZE)
+		const uint8_t *start = ctx->source_ptr - 1;
+		const uint8_t *end = scan_name(start,ctx->source_end);
+		if( (end - start) > MAX_NAME_SIZE )
 		{
 			// error out "Name to long in line" source_line_number
-			print_error(" Name is too long",source_line_number);
-			exit(-1);
+			assemble_error(ctx," Name is too long",ctx->source_line_number);
 		}
-		next_char();
+		ctx->token = start;
+		ctx->token_length = end - start;
+		ctx->source_ptr = end;
+		next_char(ctx);
+	}
+	if(ctx->token_length==0)
+	{
+		// error out "Name is blank" source_line_number
+		assemble_error(ctx,"Error Blank Name",ctx->source_line_number);		
+	}
+	if( check_white_space(ctx->new_char) )
+	{
+		clear_white_space(ctx);
+	}
+}
+
+// the name is left as written, search_op() upper cases it as it builds the key
+void load_op_name_token(Basm_Context *ctx)
+{
+	ctx->token_length = 0;
+	//clear_white_space(ctx);
+	if( CHAR_IS(ctx->new_char,CHAR_OP_NAME) )
+	{
+		const uint8_t *start = ctx->source_ptr - 1;
+		const uint8_t *end = scan_op_name(start,ctx->source_end);
+		ctx->token = start;
+		ctx->token_length = end - start;
+		ctx->source_ptr = end;
+		next_char(ctx);
 	}
-	if(tmp_token_buffer_length==0)
+	if(ctx->token_length==0)
 	{
 		// error out "Name is blank" source_line_number
-		print_error("Error Blank Name",source_line_number);
-		exit(-1);		
+		assemble_error(ctx,"Blank Name Check file end",ctx->source_line_number);		
 	}
-	if( check_white_space(new_char) )
+	if( check_white_space(ctx->new_char) )
 	{
-		clear_white_space();
+		clear_white_space(ctx);
 	}
 }
 
-void load_op_name_to_tmp()
+
+// The digits are decoded straight from the source, convert_txt_to_hex() returns the number.
+void load_hex_to_tmp(Basm_Context *ctx)
 {
-	tmp_token_buffer_length = 0;
-	//clear_white_space();
-	while( (new_char==PERIOD) || check_upper_case(new_char) || check_lower_case(new_char) )
+	int negative = 0;
+	int32_t length = 0;
+	//clear_white_space(ctx);
+
+	if(ctx->new_char == MINUS ) // handle negative number
+	{
+		negative = 1;	
+		next_char(ctx);
+	}
+	
+	if( check_hex(ctx->new_char) )
 	{
-		if( check_lower_case(new_char) )
+		const uint8_t *start = ctx->source_ptr - 1;
+		const uint8_t *end = scan_hex(start,ctx->source_end);
+		length = end - start;
+		if( length > MAX_HEX_LENGTH )
 		{
-			// convert to Upper case.
-			tmp_token_buffer[tmp_token_buffer_length] = new_char - 32 ;
+			// error out "Name to long in line" source_line_number
+			assemble_error(ctx," Number is too long",ctx->source_line_number);
 		}
-		else
+		uint32_t number = hex_value(start,length,ctx->source_end);
+		ctx->hex_number = negative ? -number : number;
+		ctx->source_ptr = end;
+		next_char(ctx);
+	}
+	if(length == 0)// check if there was a number
+	{
+		assemble_error(ctx," No number was entered",ctx->source_line_number);
+	}
+	if( check_white_space(ctx->new_char) )
+	{
+		clear_white_space(ctx);
+	}
+	
+	return;
+}
+
+void find_end_of_line(Basm_Context *ctx)
+{
+	if(ctx->new_char==LINE_END)
+	{
+		return;
+	}
+	if( check_white_space(ctx->new_char) )
 		{
-			tmp_token_buffer[tmp_token_buffer_length] = new_char;
+			clear_white_space(ctx);
 		}
-		tmp_token_buffer_length++; // this work for zero indexed.
-		if(tmp_token_buffer_length>MAX_TOKEN_SIZE)
+	//clear_white_space(ctx);
+	if(ctx->new_char == COMMENT)
+	{
+		skip_line(ctx); // skip the rest of char, return when reach LINE_END
+		return;
+	}
+	if(ctx->new_char!=LINE_END) // error on some other charector
+	{
+		// error out
+		//printf(" new_char = %i",new_char);
+		assemble_error(ctx,"Syntax Error expected Comment or end of line.. ",ctx->source_line_number);
+
+	}
+}
+
+// ---------------- Consts -------------------------
+// Consts are stored in const_buffer as [length][value][name] entries with a
+// 64 bit value, const_index points into them the way label_index does for
+// labels. A threaded chunk is handed the entries defined before it as bytes
+// and indexes them itself. Expressions are folded when the const is defined,
+// so a use is one lookup.
+
+// sets const_buffer_position to the entry of the const named by token if found
+int find_const(Basm_Context *ctx,uint32_t hash)
+{
+	uint32_t mask = ctx->const_index_size - 1;
+	uint32_t i = hash & mask;
+	if(ctx->const_index_size == 0)
+	{
+		return FALSE;
+	}
+	while(ctx->const_index[i].slot != 0)
+	{
+		STATS_COUNT(ctx,const_steps,1);
+		if(ctx->const_index[i].hash == hash)
 		{
-			// error out "Name to long in line" source_line_number
-			print_error("Error name to large",source_line_number);
-			exit(-1);
+			ctx->const_buffer_position = ctx->const_index[i].slot - 1;
+			if( (ctx->token_length==ctx->const_buffer.data[ctx->const_buffer_position]) &&
+				compare_buffer(&ctx->const_buffer.data[ctx->const_buffer_position+CONST_HEADER],ctx->token,ctx->token_length) )
+			{
+				return TRUE;
+			}
 		}
-		next_char();
+		i = (i + 1) & mask;
 	}
-	if(tmp_token_buffer_length==0)
+	return FALSE;
+}
+
+// puts the entry at position in const_index
+void index_const(Basm_Context *ctx,uint32_t position,uint32_t hash)
+{
+	if( (ctx->const_count + 1)*2 > ctx->const_index_size )
 	{
-		// error out "Name is blank" source_line_number
-		print_error("Blank Name Check file end",source_line_number);
-		exit(-1);		
+		grow_index(ctx,&ctx->const_index,&ctx->const_index_size,CONST_INDEX_START);
 	}
-	if( check_white_space(new_char) )
+	uint32_t i = hash & (ctx->const_index_size - 1);
+	while(ctx->const_index[i].slot != 0)
+	{
+		i = (i + 1) & (ctx->const_index_size - 1);
+	}
+	ctx->const_index[i].hash = hash;
+	ctx->const_index[i].slot = position + 1;
+	ctx->const_count++;
+}
+
+// adds a const find_const() did not find
+void new_const(Basm_Context *ctx,const CHAR *name,int32_t length,uint32_t hash,int64_t value)
+{
+	uint32_t position = context_alloc(ctx,&ctx->const_buffer,length + CONST_HEADER);
+	ctx->const_buffer.data[position] = length;
+	copy_buffer(&value,&ctx->const_buffer.data[position+1],sizeof(int64_t));
+	copy_buffer(name,&ctx->const_buffer.data[position+CONST_HEADER],length);
+	index_const(ctx,position,hash);
+	STATS_COUNT(ctx,consts,1);
+}
+
+// indexes the entries copied into const_buffer from start on
+void index_const_buffer(Basm_Context *ctx,uint32_t start)
+{
+	for(uint32_t pos=start;pos<ctx->const_buffer.size;pos+=ctx->const_buffer.data[pos]+CONST_HEADER)
+	{
+		index_const(ctx,pos,hash_name(&ctx->const_buffer.data[pos+CONST_HEADER],ctx->const_buffer.data[pos]));
+	}
+}
+
+// value of the const named by token
+int64_t get_const_value(Basm_Context *ctx)
+{
+	int64_t number;
+	STATS_START(ctx);
+	if( !find_const(ctx,hash_name(ctx->token,ctx->token_length)) )
+	{
+		assemble_error(ctx,"Const need to be defined before used ",ctx->source_line_number);
+	}
+	copy_buffer(&ctx->const_buffer.data[ctx->const_buffer_position+1],&number,sizeof(int64_t));
+	STATS_END(ctx,label_time);
+	return number;
+}
+
+// value of the const named by token as a word, ops and data words are 32 bits
+int32_t get_const(Basm_Context *ctx)
+{
+	int64_t number = get_const_value(ctx);
+	if( (number < INT32_MIN) || (number > UINT32_MAX) )
+	{
+		assemble_error(ctx,"Error Const does not fit in 32 bits ",ctx->source_line_number);
+	}
+	return (int32_t)(uint32_t)number;
+}
+
+// Const expressions, lowest precedence first:
+//
+//	expression	= and { | and }
+//	and			= shift { & shift }
+//	shift		= sum { << sum | >> sum }
+//	sum			= unary { + unary | - unary }
+//	unary		= - unary | ( expression ) | hex number | @name
+//
+// Each part starts on its first char and leaves new_char on the first char
+// after it that is not blank. Math is 64 bit and wraps, >> keeps the sign.
+
+int64_t const_unary(Basm_Context *ctx,int depth)
+{
+	if( (ctx->new_char == MINUS) || (ctx->new_char == L_BRACKET) )
+	{
+		// a run of minus signs nests like brackets do
+		if(depth >= MAX_CONST_DEPTH)
+		{
+			assemble_error(ctx,"Error Const expression too deep ",ctx->source_line_number);
+		}
+	}
+	if(ctx->new_char == MINUS)
+	{
+		clear_white_space(ctx);
+		return (int64_t)( 0 - (uint64_t)const_unary(ctx,depth + 1) );
+	}
+	if(ctx->new_char == L_BRACKET)
+	{
+		clear_white_space(ctx);
+		int64_t number = const_expression(ctx,depth + 1);
+		if(ctx->new_char != R_BRACKET)
+		{
+			assemble_error(ctx,"Const Syntax Incorrect",ctx->source_line_number);
+		}
+		clear_white_space(ctx);
+		return number;
+	}
+	if(ctx->new_char == AT_SIGN)
+	{
+		clear_white_space(ctx);
+		load_name_token(ctx);
+		return get_const_value(ctx);
+	}
+	if( !check_hex(ctx->new_char) )
+	{
+		assemble_error(ctx," No number was entered",ctx->source_line_number);
+	}
+	const uint8_t *start = ctx->source_ptr - 1;
+	const uint8_t *end = scan_hex(start,ctx->source_end);
+	int32_t length = end - start;
+	if(length > MAX_CONST_HEX_LENGTH)
+	{
+		assemble_error(ctx," Number is too long",ctx->source_line_number);
+	}
+	uint64_t number = hex_value(start,(length > HEX_WORD_DIGITS) ? HEX_WORD_DIGITS : length,ctx->source_end);
+	if(length > HEX_WORD_DIGITS)
+	{
+		// the first eight digits are the high part
+		uint32_t low = hex_value(start + HEX_WORD_DIGITS,length - HEX_WORD_DIGITS,ctx->source_end);
+		number = (number << ( (length - HEX_WORD_DIGITS) * 4 )) | low;
+	}
+	ctx->source_ptr = end;
+	next_char(ctx);
+	if( check_white_space(ctx->new_char) )
+	{
+		clear_white_space(ctx);
+	}
+	return (int64_t)number;
+}
+
+int64_t const_sum(Basm_Context *ctx,int depth)
+{
+	int64_t number = const_unary(ctx,depth);
+	while( (ctx->new_char == PLUS) || (ctx->new_char == MINUS) )
+	{
+		int add = (ctx->new_char == PLUS);
+		clear_white_space(ctx);
+		uint64_t right = const_unary(ctx,depth);
+		number = (int64_t)( add ? (uint64_t)number + right : (uint64_t)number - right );
+	}
+	return number;
+}
+
+int64_t const_shift(Basm_Context *ctx,int depth)
+{
+	int64_t number = const_sum(ctx,depth);
+	while( (ctx->new_char == LESS_THAN) || (ctx->new_char == GREATER_THAN) )
+	{
+		CHAR shift = ctx->new_char;
+		next_char(ctx);
+		if(ctx->new_char != shift)
+		{
+			assemble_error(ctx,"Const Syntax Incorrect",ctx->source_line_number);
+		}
+		clear_white_space(ctx);
+		int64_t count = const_sum(ctx,depth);
+		if( (count < 0) || (count > 63) )
+		{
+			assemble_error(ctx,"Error Shift out of range ",ctx->source_line_number);
+		}
+		if(shift == LESS_THAN)
+		{
+			number = (int64_t)( (uint64_t)number << count );
+		}
+		else
+		{
+			// written out so the sign is kept on any compiler
+			number = (number < 0) ? ~( ~number >> count ) : number >> count;
+		}
+	}
+	return number;
+}
+
+int64_t const_and(Basm_Context *ctx,int depth)
+{
+	int64_t number = const_shift(ctx,depth);
+	while(ctx->new_char == AMPERSAND)
+	{
+		clear_white_space(ctx);
+		number &= const_shift(ctx,depth);
+	}
+	return number;
+}
+
+int64_t const_expression(Basm_Context *ctx,int depth)
+{
+	int64_t number = const_and(ctx,depth);
+	while(ctx->new_char == PIPE)
+	{
+		clear_white_space(ctx);
+		number |= const_and(ctx,depth);
+	}
+	return number;
+}
+
+int32_t convert_txt_to_hex(Basm_Context *ctx)
+{
+	// decoded by the last load_hex_to_tmp()
+	return ctx->hex_number;
+}
+
+/*
+void next_label()		 // %0 
+{
+	
+	ctx->label_buffer_position = ctx->label_buffer_position + ctx->label_buffer.data[ctx->label_buffer_position] + 5;
+		
+}
+*/
+
+void get_label(Basm_Context *ctx);			 // %0
+
+// remember an op that uses a label not reached yet, file_finish() fills it in
+void save_op(Basm_Context *ctx,uint8_t id,uint8_t rd,uint8_t rs1,uint8_t rs2,uint32_t label_pos)
+{
+	uint32_t code = 0;
+	// encode everything but the offset now, it is added in with the label address
+	switch(op_info[id].op_type)
+	{
+		case TYPE_I:
+			code = I_Type(0, rs1, op_info[id].fun3, rd, op_info[id].op);
+			break;
+		case TYPE_B:
+			code = B_Type(0, rs2, rs1, op_info[id].fun3, op_info[id].op);
+			break;
+		case TYPE_S:
+			code = S_Type(0, rs1, rs2, op_info[id].fun3, op_info[id].op);
+			break;
+		case TYPE_J:
+			code = J_Type(0, rd, op_info[id].op);
+			break;
+		case TYPE_U:
+			code = U_Type(0, rd, op_info[id].op);
+			break;
+		default:
+			assemble_error(ctx,"Error OP can not use a label ",ctx->source_line_number);
+	}
+	add_fixup(ctx,op_info[id].op_type,ctx->output_code_position,label_pos,code);
+}
+
+void add_fixup(Basm_Context *ctx,uint8_t type,uint32_t op_pos,uint32_t label_pos,uint32_t code)
+{
+	Fixups *fixups = &ctx->fixups[type];
+	uint32_t offset = context_alloc(ctx,&fixups->op_pos,sizeof(uint32_t));
+	copy_buffer(&op_pos,&fixups->op_pos.data[offset],sizeof(uint32_t));
+	offset = context_alloc(ctx,&fixups->label_pos,sizeof(uint32_t));
+	copy_buffer(&label_pos,&fixups->label_pos.data[offset],sizeof(uint32_t));
+	offset = context_alloc(ctx,&fixups->code,sizeof(uint32_t));
+	copy_buffer(&code,&fixups->code.data[offset],sizeof(uint32_t));
+	if( ctx->relax || ctx->streamed )
+	{
+		offset = context_alloc(ctx,&fixups->line,sizeof(uint32_t));
+		copy_buffer(&ctx->source_line_number,&fixups->line.data[offset],sizeof(uint32_t));
+	}
+	fixups->count++;
+}
+
+
+//
+
+
+// ----------------- Range Checks -------------------
+
+int check_white_space(CHAR check)
+{
+	return CHAR_IS(check,CHAR_BLANK);
+}
+
+int check_numbers(CHAR check) // numbers = 48 - 57
+{
+	return CHAR_IS(check,CHAR_DIGIT);
+}
+
+int check_hex(CHAR check)
+{
+	return CHAR_IS(check,CHAR_HEX);
+}
+
+// ---------------------------------------------------
+
+int compare_buffer(const CHAR *a,const CHAR *b,int size)
+{
+	for(int i=0;i < size; i++)
+	{
+		if(a[i]==b[i])
+		{
+			continue;
+		}
+		else
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;	
+}		 
+void copy_buffer(const void *src,void *dst,int size)
+{
+	for(int i = 0; i<size ;i++)
+	{
+		((uint8_t*)dst)[i] = ((const uint8_t*)src)[i];
+	}
+}
+
+// FNV-1a, used to index label names
+uint32_t hash_name(const CHAR *name,int size)
+{
+	uint32_t hash = 2166136261u;
+	for(int i = 0; i<size ;i++)
+	{
+		hash = (hash ^ name[i]) * 16777619u;
+	}
+	return hash;
+}
+
+void zero_buffer(void *buffer,int size)
+{
+	for(int i =0;i<size;i++)
+	{
+		((uint8_t*)buffer)[i] = 0;
+	}
+	return;
+}
+
+
+// -------- Library ------------------------------------
+
+// Stops assembling, basm_assemble() returns the error to the caller.
+_Noreturn void assemble_error(Basm_Context *ctx,char *error,int source_code_number)
+{
+	snprintf(ctx->out->error,BASM_ERROR_SIZE,"%s",error);
+	ctx->out->error_line = (source_code_number>=0) ? source_code_number+1 : 0;
+	longjmp(ctx->error_jump,1);
+}
+
+// returns the offset of bytes new bytes in arena
+uint32_t context_alloc(Basm_Context *ctx,Arena *arena,uint32_t bytes)
+{
+	if( !arena_reserve(arena,bytes) )
+	{
+		assemble_error(ctx,"Error Out of memory ",-1);
+	}
+	uint32_t offset = arena->size;
+	arena->size += bytes;
+	return offset;
+}
+
+// ctx must be zeroed, the source from start to end is assembled into it
+void init_context(Basm_Context *ctx,const uint8_t *start,const uint8_t *end,basm_output *out)
+{
+	ctx->source_ptr = start;
+	ctx->source_end = end;
+	ctx->new_char = SPACE;
+	ctx->out = out;
+}
+
+void free_context(Basm_Context *ctx)
+{
+	arena_free(&ctx->label_buffer);
+	arena_free(&ctx->const_buffer);
+	for(int type=0;type<NUMBER_OF_TYPES;type++)
+	{
+		arena_free(&ctx->fixups[type].op_pos);
+		arena_free(&ctx->fixups[type].label_pos);
+		arena_free(&ctx->fixups[type].code);
+		arena_free(&ctx->fixups[type].line);
+	}
+	arena_free(&ctx->fixup_offsets);
+	arena_free(&ctx->relax_ops);
+	arena_free(&ctx->warnings);
+	arena_free(&ctx->messages);
+	arena_free(&ctx->output_code);
+	free(ctx->label_index);
+	ctx->label_index = NULL;
+	ctx->label_index_size = 0;
+	free(ctx->const_index);
+	ctx->const_index = NULL;
+	ctx->const_index_size = 0;
+}
+
+int run_assembler(Basm_Context *ctx)
+{
+	if( setjmp(ctx->error_jump) )
+	{
+		return FALSE;
+	}
+	if(ctx->stats == NULL)
+	{
+		start_parser(ctx);
+		file_finish(ctx);
+		return TRUE;
+	}
+	basm_stats *stats = ctx->stats;
+	double start = stats_now();
+	start_parser(ctx);
+	double parsed = stats_now();
+	file_finish(ctx);
+	double finished = stats_now();
+	stats->total_time = finished - start;
+	stats->fixup_time = finished - parsed;
+	// what is left of the parse time is reading and splitting up the source
+	stats->tokenize_time = (parsed - start) - stats->op_lookup_time - stats->label_time - stats->encode_time;
+	stats->lines = ctx->source_line_number;
+	stats->labels = ctx->label_count;
+	for(int type=0;type<NUMBER_OF_TYPES;type++)
+	{
+		stats->forward_refs += ctx->fixups[type].count;
+	}
+	stats->bytes_written = ctx->output_code.size;
+	return TRUE;
+}
+
+int basm_assemble(const char *src,size_t len,basm_output *out)
+{
+	return basm_assemble_stats(src,len,out,NULL);
+}
+
+// a context for a single pass over the source, NULL with out->error set if out of memory
+Basm_Context* new_context(const char *src,size_t len,basm_output *out)
+{
+	Basm_Context *ctx = calloc(1,sizeof(Basm_Context));
+	out->data = NULL;
+	out->size = 0;
+	out->error_line = 0;
+	out->error[0] = 0;
+	out->messages = NULL;
+	if(ctx == NULL)
+	{
+		snprintf(out->error,BASM_ERROR_SIZE,"%s","Error Out of memory ");
+		return NULL;
+	}
+	init_context(ctx,(const uint8_t*)src,(const uint8_t*)src + len,out);
+	return ctx;
+}
+
+int basm_assemble_stats(const char *src,size_t len,basm_output *out,basm_stats *stats)
+{
+	return basm_assemble_flags(src,len,0,out,stats);
+}
+
+int basm_assemble_flags(const char *src,size_t len,int flags,basm_output *out,basm_stats *stats)
+{
+	return basm_assemble_dir(src,len,flags,NULL,out,stats);
+}
+
+int basm_assemble_dir(const char *src,size_t len,int flags,const char *dir,basm_output *out,basm_stats *stats)
+{
+	Basm_Context *ctx = new_context(src,len,out);
+	if(ctx == NULL)
+	{
+		return -1;
+	}
+	ctx->compress = (flags & BASM_COMPRESS) != 0;
+	ctx->relax = (flags & BASM_RELAX) != 0;
+	ctx->relax_scratch = (flags & BASM_RELAX_SCRATCH_MASK) >> BASM_RELAX_SCRATCH_SHIFT;
+	ctx->no_data_files = (flags & BASM_NO_DATA_FILES) != 0;
+	ctx->data_dir = dir;
+	ctx->keep_messages = (flags & BASM_KEEP_MESSAGES) != 0;
+	if(stats != NULL)
+	{
+		memset(stats,0,sizeof(basm_stats));
+		ctx->stats = stats;
+	}
+
+	int assembled = run_assembler(ctx);
+	if(assembled)
+	{
+		// hand the image over to the caller
+		out->data = ctx->output_code.data;
+		out->size = ctx->output_code.size;
+		ctx->output_code.data = NULL;
+	}
+	if(ctx->messages.size != 0)
+	{
+		// the warnings before an error are kept too
+		out->messages = (char*)ctx->messages.data;
+		ctx->messages.data = NULL;
+	}
+	free_context(ctx);
+	free(ctx);
+	return assembled ? 0 : -1;
+}
+
+void basm_output_free(basm_output *out)
+{
+	free(out->data);
+	out->data = NULL;
+	out->size = 0;
+	free(out->messages);
+	out->messages = NULL;
+}
+
+// A session is a context that is emptied instead of freed between sources,
+// its arenas keep their memory so a small source allocates nothing.
+struct basm_session
+{
+	Basm_Context	ctx;
+};
+
+// empties an index, one grown by a big source is dropped instead so small
+// ones do not clear all of it
+void reset_index(Label_Index **index,uint32_t *size,uint32_t start_size)
+{
+	if(*size > start_size)
+	{
+		free(*index);
+		*index = NULL;
+		*size = 0;
+	}
+	else if(*index != NULL)
+	{
+		memset(*index,0,*size*sizeof(Label_Index));
+	}
+}
+
+// zeros ctx for the next source but keeps the memory of every arena and index
+void reset_context(Basm_Context *ctx)
+{
+	Arena label_buffer = ctx->label_buffer;
+	Arena const_buffer = ctx->const_buffer;
+	Fixups fixups[NUMBER_OF_TYPES];
+	memcpy(fixups,ctx->fixups,sizeof(fixups));
+	Arena fixup_offsets = ctx->fixup_offsets;
+	Arena relax_ops = ctx->relax_ops;
+	Arena messages = ctx->messages;
+	Arena output_code = ctx->output_code;
+	Label_Index *label_index = ctx->label_index;
+	uint32_t label_index_size = ctx->label_index_size;
+	Label_Index *const_index = ctx->const_index;
+	uint32_t const_index_size = ctx->const_index_size;
+	reset_index(&label_index,&label_index_size,LABEL_INDEX_START);
+	reset_index(&const_index,&const_index_size,CONST_INDEX_START);
+
+	memset(ctx,0,sizeof(Basm_Context));
+	ctx->label_buffer = label_buffer;
+	ctx->const_buffer = const_buffer;
+	memcpy(ctx->fixups,fixups,sizeof(fixups));
+	for(int type=0;type<NUMBER_OF_TYPES;type++)
+	{
+		ctx->fixups[type].count = 0;
+		arena_reset(&ctx->fixups[type].op_pos);
+		arena_reset(&ctx->fixups[type].label_pos);
+		arena_reset(&ctx->fixups[type].code);
+		arena_reset(&ctx->fixups[type].line);
+	}
+	ctx->fixup_offsets = fixup_offsets;
+	ctx->relax_ops = relax_ops;
+	ctx->messages = messages;
+	ctx->output_code = output_code;
+	ctx->label_index = label_index;
+	ctx->label_index_size = label_index_size;
+	ctx->const_index = const_index;
+	ctx->const_index_size = const_index_size;
+	arena_reset(&ctx->label_buffer);
+	arena_reset(&ctx->const_buffer);
+	arena_reset(&ctx->fixup_offsets);
+	arena_reset(&ctx->relax_ops);
+	arena_reset(&ctx->messages);
+	arena_reset(&ctx->output_code);
+}
+
+basm_session* basm_session_new(void)
+{
+	return calloc(1,sizeof(basm_session));
+}
+
+void basm_session_free(basm_session *session)
+{
+	if(session == NULL)
+	{
+		return;
+	}
+	free_context(&session->ctx);
+	free(session);
+}
+
+int basm_assemble_session(basm_session *session,const char *src,size_t len,int flags,basm_output *out)
+{
+	Basm_Context *ctx = &session->ctx;
+	reset_context(ctx);
+	out->data = NULL;
+	out->size = 0;
+	out->error_line = 0;
+	out->error[0] = 0;
+	out->messages = NULL;
+	init_context(ctx,(const uint8_t*)src,(const uint8_t*)src + len,out);
+	ctx->compress = (flags & BASM_COMPRESS) != 0;
+	ctx->relax = (flags & BASM_RELAX) != 0;
+	ctx->relax_scratch = (flags & BASM_RELAX_SCRATCH_MASK) >> BASM_RELAX_SCRATCH_SHIFT;
+	ctx->no_data_files = (flags & BASM_NO_DATA_FILES) != 0;
+	ctx->keep_messages = (flags & BASM_KEEP_MESSAGES) != 0;
+	int assembled = run_assembler(ctx);
+	if(ctx->messages.size != 0)
+	{
+		out->messages = (char*)ctx->messages.data;
+	}
+	if(!assembled)
+	{
+		return -1;
+	}
+	// the image stays in the session until the next call
+	out->data = ctx->output_code.data;
+	out->size = ctx->output_code.size;
+	return 0;
+}
+
+// -------- ELF ------------------------------------------
+// The image is wrapped as it is, labels become global symbols. An executable
+// is one RWX segment at ELF_BASE_ADDRESS with the data after the last op in
+// .data. A relocatable file keeps the whole image in .text and has no .data,
+// ops there reach data labels with offsets fixed at assembly time, so the
+// data can not be moved away from them by the linker. Branches and jumps to
+// labels that were never reached get relocations instead of an error.
+
+#define ELF_PUT(DATA,SIZE)	do{ if( !elf_put(file,&position,(DATA),(SIZE)) ){ goto write_error; } }while(0)
+#define ELF_PAD(OFFSET)		do{ if( !elf_pad(file,&position,(OFFSET)) ){ goto write_error; } }while(0)
+
+// symbol index of the label whose address is at label_pos, entries is every
+// label_buffer entry position in order
+uint32_t elf_label_symbol(const uint32_t *entries,uint32_t count,uint32_t label_pos,uint32_t first_label)
+{
+	uint32_t low = 0;
+	uint32_t high = count;
+	while(low + 1 < high)
+	{
+		uint32_t middle = (low + high) / 2;
+		if(entries[middle] < label_pos)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return first_label + low;
+}
+
+void elf_section(Elf_Section_Header *section,uint32_t name,uint32_t type,uint64_t flags,uint64_t offset,uint64_t size)
+{
+	zero_buffer(section,sizeof(Elf_Section_Header));
+	section->name = name;
+	section->type = type;
+	section->flags = flags;
+	section->offset = offset;
+	section->size = size;
+	section->align = 1;
+}
+
+// Streams the finished image out as ELF in one pass, every offset is worked
+// out from the label and fixup counts before the first byte is written.
+void write_elf(Basm_Context *ctx,int flags,FILE *file)
+{
+	int executable = (flags & BASM_ELF_EXECUTABLE) != 0;
+	uint32_t size = ctx->output_code.size;
+	uint32_t text_size = executable ? ctx->text_end : size;
+	uint64_t base = executable ? ELF_BASE_ADDRESS : 0;
+	// sections and symbols after .data move down one in a relocatable file
+	uint32_t skip = executable ? 0 : 1;
+	uint32_t first_label = ELF_FIRST_LABEL_SYMBOL - skip;
+
+	// label_buffer entry positions, the scratch offsets are free once file_finish() is done
+	arena_reset(&ctx->fixup_offsets);
+	context_alloc(ctx,&ctx->fixup_offsets,ctx->label_count*sizeof(uint32_t));
+	uint32_t *entries = (uint32_t*)ctx->fixup_offsets.data;
+	uint64_t strtab_size = 1;
+	for(uint32_t pos = 0,i = 0;pos < ctx->label_buffer.size;i++)
+	{
+		entries[i] = pos;
+		strtab_size += ctx->label_buffer.data[pos] + 1;
+		pos += ctx->label_buffer.data[pos] + LABEL_HEADER;
+	}
+	uint32_t relocation_count = 0;
+	if(!executable)
+	{
+		for(int type=TYPE_I;type<NUMBER_OF_TYPES;type++)
+		{
+			if( (type != TYPE_B) && (type != TYPE_J) )
+			{
+				continue;
+			}
+			Fixups *fixups = &ctx->fixups[type];
+			uint32_t *label_pos = (uint32_t*)fixups->label_pos.data;
+			for(uint32_t i=0;i<fixups->count;i++)
+			{
+				uint32_t label_addr;
+				copy_buffer(&ctx->label_buffer.data[label_pos[i]],&label_addr,OP_CODE_SIZE);
+				relocation_count += (label_addr == LABEL_UNDEFINED);
+			}
+		}
+	}
+
+	uint64_t image_offset = executable ? ELF_PAGE_SIZE : sizeof(Elf_Header);
+	uint64_t symtab_offset = ELF_ALIGN(image_offset + size,8);
+	uint64_t symtab_size = (uint64_t)(first_label + ctx->label_count) * sizeof(Elf_Symbol);
+	uint64_t strtab_offset = symtab_offset + symtab_size;
+	uint64_t shstrtab_offset = strtab_offset + strtab_size;
+	uint64_t rela_offset = ELF_ALIGN(shstrtab_offset + sizeof(ELF_SECTION_NAMES),8);
+	uint64_t rela_size = (uint64_t)relocation_count * sizeof(Elf_Rela);
+	uint64_t section_offset = ELF_ALIGN(rela_offset + rela_size,8);
+	uint16_t section_count = ELF_SECTION_RELA;	// an executable has no .rela.text, a relocatable file no .data
+	uint64_t position = 0;
+
+	Elf_Header header =
+	{
+		.ident = {0x7f,'E','L','F',ELF_CLASS64,ELF_DATA_LSB,ELF_VERSION},
+		.type = executable ? ELF_TYPE_EXEC : ELF_TYPE_REL,
+		.machine = ELF_MACHINE_RISCV,
+		.version = ELF_VERSION,
+		.entry = base,
+		.program_header_offset = executable ? sizeof(Elf_Header) : 0,
+		.section_header_offset = section_offset,
+		.flags = ctx->compress ? ELF_FLAG_RVC : 0,
+		.header_size = sizeof(Elf_Header),
+		.program_header_size = executable ? sizeof(Elf_Program_Header) : 0,
+		.program_header_count = executable ? 1 : 0,
+		.section_header_size = sizeof(Elf_Section_Header),
+		.section_header_count = section_count,
+		.section_names = ELF_SECTION_SHSTRTAB - skip,
+	};
+	ELF_PUT(&header,sizeof(header));
+	if(executable)
+	{
+		Elf_Program_Header segment = {0};
+		segment.type = ELF_PT_LOAD;
+		segment.flags = ELF_PF_RWX;
+		segment.offset = image_offset;
+		segment.address = base;
+		segment.physical_address = base;
+		segment.file_size = size;
+		segment.memory_size = size;
+		segment.align = ELF_PAGE_SIZE;
+		ELF_PUT(&segment,sizeof(segment));
+	}
+
+	// .text and .data if there is one, straight from the image
+	ELF_PAD(image_offset);
+	ELF_PUT(ctx->output_code.data,size);
+
+	// .symtab, the locals are the null symbol and the sections
+	ELF_PAD(symtab_offset);
+	Elf_Symbol symbol = {0};
+	ELF_PUT(&symbol,sizeof(symbol));
+	symbol.info = ELF_SYMBOL(ELF_STB_LOCAL,ELF_STT_SECTION);
+	symbol.section = ELF_SECTION_TEXT;
+	symbol.value = base;
+	ELF_PUT(&symbol,sizeof(symbol));
+	if(executable)
+	{
+		symbol.section = ELF_SECTION_DATA;
+		symbol.value = base + text_size;
+		ELF_PUT(&symbol,sizeof(symbol));
+	}
+	uint32_t name = 1;
+	for(uint32_t i=0;i<ctx->label_count;i++)
+	{
+		uint32_t label_addr;
+		copy_buffer(&ctx->label_buffer.data[entries[i]+1],&label_addr,OP_CODE_SIZE);
+		zero_buffer(&symbol,sizeof(symbol));
+		symbol.name = name;
+		symbol.info = ELF_SYMBOL(ELF_STB_GLOBAL,ELF_STT_NOTYPE);
+		if(label_addr != LABEL_UNDEFINED)
+		{
+			int in_data = (label_addr >= text_size) && (text_size < size);
+			symbol.section = in_data ? ELF_SECTION_DATA : ELF_SECTION_TEXT;
+			// section offsets in a relocatable file, addresses in an executable
+			symbol.value = executable ? base + label_addr : label_addr - (in_data ? text_size : 0);
+		}
+		ELF_PUT(&symbol,sizeof(symbol));
+		name += ctx->label_buffer.data[entries[i]] + 1;
+	}
+
+	// .strtab
+	ELF_PUT("",1);
+	for(uint32_t i=0;i<ctx->label_count;i++)
+	{
+		ELF_PUT(&ctx->label_buffer.data[entries[i]+LABEL_HEADER],ctx->label_buffer.data[entries[i]]);
+		ELF_PUT("",1);
+	}
+	ELF_PUT(ELF_SECTION_NAMES,sizeof(ELF_SECTION_NAMES));
+
+	// .rela.text, a zero offset is already in the op
+	ELF_PAD(rela_offset);
+	for(int type=TYPE_I;(type<NUMBER_OF_TYPES) && relocation_count;type++)
+	{
+		if( (type != TYPE_B) && (type != TYPE_J) )
+		{
+			continue;
+		}
+		Fixups *fixups = &ctx->fixups[type];
+		uint32_t *op_pos = (uint32_t*)fixups->op_pos.data;
+		uint32_t *label_pos = (uint32_t*)fixups->label_pos.data;
+		for(uint32_t i=0;i<fixups->count;i++)
+		{
+			uint32_t label_addr;
+			copy_buffer(&ctx->label_buffer.data[label_pos[i]],&label_addr,OP_CODE_SIZE);
+			if(label_addr == LABEL_UNDEFINED)
+			{
+				Elf_Rela rela;
+				rela.offset = op_pos[i];
+				rela.info = ELF_R_INFO(elf_label_symbol(entries,ctx->label_count,label_pos[i],first_label),
+									   (type == TYPE_J) ? ELF_R_RISCV_JAL : ELF_R_RISCV_BRANCH);
+				rela.addend = 0;
+				ELF_PUT(&rela,sizeof(rela));
+			}
+		}
+	}
+
+	ELF_PAD(section_offset);
+	Elf_Section_Header sections[ELF_SECTION_RELA + 1];
+	zero_buffer(&sections[ELF_SECTION_NULL],sizeof(Elf_Section_Header));
+	elf_section(&sections[ELF_SECTION_TEXT],ELF_NAME_TEXT,ELF_SHT_PROGBITS,ELF_SHF_ALLOC | ELF_SHF_EXEC,image_offset,text_size);
+	sections[ELF_SECTION_TEXT].address = base;
+	sections[ELF_SECTION_TEXT].align = OP_CODE_SIZE;
+	elf_section(&sections[ELF_SECTION_DATA],ELF_NAME_DATA,ELF_SHT_PROGBITS,ELF_SHF_ALLOC | ELF_SHF_WRITE,image_offset + text_size,size - text_size);
+	sections[ELF_SECTION_DATA].address = executable ? base + text_size : 0;
+	sections[ELF_SECTION_DATA].align = OP_CODE_SIZE;
+	elf_section(&sections[ELF_SECTION_SYMTAB],ELF_NAME_SYMTAB,ELF_SHT_SYMTAB,0,symtab_offset,symtab_size);
+	sections[ELF_SECTION_SYMTAB].link = ELF_SECTION_STRTAB - skip;
+	sections[ELF_SECTION_SYMTAB].info = first_label;	// first global
+	sections[ELF_SECTION_SYMTAB].align = 8;
+	sections[ELF_SECTION_SYMTAB].entry_size = sizeof(Elf_Symbol);
+	elf_section(&sections[ELF_SECTION_STRTAB],ELF_NAME_STRTAB,ELF_SHT_STRTAB,0,strtab_offset,strtab_size);
+	elf_section(&sections[ELF_SECTION_SHSTRTAB],ELF_NAME_SHSTRTAB,ELF_SHT_STRTAB,0,shstrtab_offset,sizeof(ELF_SECTION_NAMES));
+	elf_section(&sections[ELF_SECTION_RELA],ELF_NAME_RELA,ELF_SHT_RELA,ELF_SHF_INFO_LINK,rela_offset,rela_size);
+	sections[ELF_SECTION_RELA].link = ELF_SECTION_SYMTAB - skip;
+	sections[ELF_SECTION_RELA].info = ELF_SECTION_TEXT;
+	sections[ELF_SECTION_RELA].align = 8;
+	sections[ELF_SECTION_RELA].entry_size = sizeof(Elf_Rela);
+	ELF_PUT(sections,ELF_SECTION_DATA*sizeof(Elf_Section_Header));
+	ELF_PUT(&sections[ELF_SECTION_DATA + skip],(section_count - ELF_SECTION_DATA)*sizeof(Elf_Section_Header));
+	ctx->out->size = position;
+	return;
+
+write_error:
+	assemble_error(ctx,"\n Error writing file",-1);
+}
+
+int run_elf(Basm_Context *ctx,int flags,FILE *file)
+{
+	if( setjmp(ctx->error_jump) )
+	{
+		return FALSE;
+	}
+	start_parser(ctx);
+	file_finish(ctx);
+	write_elf(ctx,flags,file);
+	return TRUE;
+}
+
+int basm_assemble_elf(const char *src,size_t len,int flags,FILE *file,basm_output *out)
+{
+	return assemble_elf_dir(src,len,flags,NULL,file,out);
+}
+
+// basm_assemble_elf() with $f paths read from dir, see basm_assemble_dir()
+int assemble_elf_dir(const char *src,size_t len,int flags,const char *dir,FILE *file,basm_output *out)
+{
+	Basm_Context *ctx = new_context(src,len,out);
+	if(ctx == NULL)
+	{
+		return -1;
+	}
+	ctx->keep_undefined = (flags & BASM_ELF_RELOCATABLE) != 0;
+	ctx->compress = (flags & BASM_COMPRESS) != 0;
+	ctx->relax = (flags & BASM_RELAX) != 0;
+	ctx->relax_scratch = (flags & BASM_RELAX_SCRATCH_MASK) >> BASM_RELAX_SCRATCH_SHIFT;
+	ctx->no_data_files = (flags & BASM_NO_DATA_FILES) != 0;
+	ctx->data_dir = dir;
+	int assembled = run_elf(ctx,flags,file);
+	free_context(ctx);
+	free(ctx);
+	return assembled ? 0 : -1;
+}
+
+// -------- Parallel ---------------------------------------
+// A large source is split at line ends into chunks that are parsed on their
+// own threads. Every line makes 0 or OP_CODE_SIZE bytes, so a quick scan of
+// the first char on each line gives the base address of every chunk.
+// Each chunk is parsed as if it started at address 0, its labels and saved
+// ops are moved to its base address when the chunks are merged. Labels are
+// kept per chunk, ops that use a label the chunk did not reach are saved as
+// usual and resolved against all chunks in the merge pass.
+// Constants must be defined before use, they are read in order first and
+// each chunk starts with the ones defined above it.
+// Any error falls back to basm_assemble() so messages match the single pass.
+
+typedef struct Chunk
+{
+	const uint8_t*	start;
+	const uint8_t*	end;
+	uint32_t		first_line;		// source line number at start
+	uint32_t		line_count;
+	uint32_t		byte_count;		// op and data lines
+	uint32_t		base_address;
+	uint32_t		const_seed;		// const_buffer bytes defined before this chunk
+	Arena			const_lines;	// offsets of the @ on const lines
+	const Arena*	consts;			// const_buffer read by the first pass
+	Basm_Context*	ctx;
+	basm_output		out;
+	int				keep_warnings;	// warnings are kept in ctx for the region cache
+	int				failed;
+}Chunk;
+
+// bytes a $ line at ptr adds to the image, FALSE when the first pass can not
+// tell, $f needs the file and anything malformed is left to the serial parser
+int chunk_data_size(const uint8_t *ptr,const uint8_t *end,uint32_t *bytes)
+{
+	ptr = scan_blank(ptr + 1,end);
+	if( (ptr == end) || (*ptr == L_SQUARE_BRACKET) || (*ptr == AT_SIGN) )
+	{
+		*bytes = OP_CODE_SIZE;
+		return TRUE;
+	}
+	uint32_t unit;
+	switch(*ptr)
+	{
+		case DATA_BYTES:	unit = 1; break;
+		case DATA_HALVES:	unit = 2; break;
+		case DATA_WORDS:	unit = 4; break;
+		default:			return FALSE;
+	}
+	ptr = scan_blank(ptr + 1,end);
+	if( (ptr == end) || (*ptr != L_SQUARE_BRACKET) )
+	{
+		return FALSE;
+	}
+	uint64_t size = 0;
+	ptr++;
+	while(TRUE)
+	{
+		ptr = scan_blank(ptr,end);
+		if( (ptr < end) && (*ptr == COMMA) )
+		{
+			ptr = scan_blank(ptr + 1,end);
+		}
+		if( (ptr < end) && (*ptr == MINUS) )
+		{
+			ptr++;
+		}
+		const uint8_t *run = scan_hex(ptr,end);
+		if(run == ptr)
+		{
+			break;
+		}
+		size += (unit == 1) ? (uint64_t)(run - ptr) / 2 : unit;
+		ptr = run;
+	}
+	if( (ptr == end) || (*ptr != R_SQUARE_BRACKET) || (size > ARENA_MAX_SIZE) )
+	{
+		return FALSE;
+	}
+	*bytes = (size + OP_CODE_SIZE - 1) & ~(uint64_t)(OP_CODE_SIZE - 1);
+	return TRUE;
+}
+
+// first pass, classify every line of the chunk by its first char
+void* chunk_scan(void *arg)
+{
+	Chunk *chunk = arg;
+	const uint8_t *ptr = chunk->start;
+	uint32_t bytes;
+	while(ptr < chunk->end)
+	{
+		while( (ptr < chunk->end) && ( (*ptr == SPACE) || (*ptr == TAB) ) )
+		{
+			ptr++;
+		}
+		if(ptr == chunk->end)
+		{
+			break;
+		}
+		switch(*ptr)
+		{
+			case LINE_END:
+			case COMMENT:
+			case COLON:
+				break;
+			case AT_SIGN:
+				if( !arena_reserve(&chunk->const_lines,sizeof(uint32_t)) )
+				{
+					chunk->failed = TRUE;
+					return NULL;
+				}
+				uint32_t offset = ptr - chunk->start;
+				copy_buffer(&offset,&chunk->const_lines.data[chunk->const_lines.size],sizeof(uint32_t));
+				chunk->const_lines.size += sizeof(uint32_t);
+				break;
+			case 0:
+				// the parser steps over a zero at the start of a line, leave that to it
+				chunk->failed = TRUE;
+				return NULL;
+			case DOLLAR_SIGN:
+				if( !chunk_data_size(ptr,chunk->end,&bytes) || ( (uint64_t)chunk->byte_count + bytes > ARENA_MAX_SIZE ) )
+				{
+					chunk->failed = TRUE;
+					return NULL;
+				}
+				chunk->byte_count += bytes;
+				break;
+			default:
+				chunk->byte_count += OP_CODE_SIZE; // op
+				break;
+		}
+		const uint8_t *line_end = memchr(ptr,LINE_END,chunk->end - ptr);
+		if(line_end == NULL)
+		{
+			break;
+		}
+		chunk->line_count++;
+		ptr = line_end + 1;
+	}
+	return NULL;
+}
+
+int run_chunk(Chunk *chunk)
+{
+	Basm_Context *ctx = chunk->ctx;
+	if( setjmp(ctx->error_jump) )
+	{
+		return FALSE;
+	}
+	if(chunk->const_seed)
+	{
+		uint32_t offset = context_alloc(ctx,&ctx->const_buffer,chunk->const_seed);
+		copy_buffer(chunk->consts->data,&ctx->const_buffer.data[offset],chunk->const_seed);
+		index_const_buffer(ctx,offset);
+	}
+	start_parser(ctx);
+	return ctx->output_code_position == chunk->byte_count;
+}
+
+// patches the saved ops whose label has been reached since and drops them,
+// out of range ones are kept so file_finish() warns about them in order.
+// A streamed op can not be kept that long, it would hold the image back
+// for good: one out of range is patched now and counted for file_finish(),
+// one whose label is still missing STREAM_MAX_HELD bytes on is an error.
+
+#define STREAM_MAX_HELD		(SIGNED_20_BIT_MAX + 1)	// image bytes an op may hold back, the reach of a JAL
+
+void resolve_reached_fixups(Basm_Context *ctx)
+{
+	for(int type=TYPE_I;type<NUMBER_OF_TYPES;type++)
+	{
+		Fixups *fixups = &ctx->fixups[type];
+		uint32_t *op_pos = (uint32_t*)fixups->op_pos.data;
+		uint32_t *label_pos = (uint32_t*)fixups->label_pos.data;
+		uint32_t *code = (uint32_t*)fixups->code.data;
+		uint32_t *line = (uint32_t*)fixups->line.data;
+		uint32_t kept = 0;
+		for(uint32_t n=0;n<fixups->count;n++)
+		{
+			uint32_t label_addr;
+			copy_buffer(&ctx->label_buffer.data[label_pos[n]],&label_addr,OP_CODE_SIZE);
+			int32_t offset = label_addr - op_pos[n];
+			int wide = (type == TYPE_J) || (type == TYPE_U);
+			int fits = wide ? C_FITS(offset,SIGNED_20_BIT_MIN,SIGNED_20_BIT_MAX) : C_FITS(offset,SIGNED_12_BIT_MIN,SIGNED_12_BIT_MAX);
+			if( ctx->streamed && (label_addr == LABEL_UNDEFINED) && (ctx->output_code_position - op_pos[n] > STREAM_MAX_HELD) )
+			{
+				assemble_error(ctx,"Error Label out of reach of a streamed op ",line[n]);
+			}
+			if( (label_addr != LABEL_UNDEFINED) && ( fits || ctx->streamed ) )
+			{
+				ctx->streamed_out_of_range += !fits;
+				switch(type)
+				{
+					case TYPE_I:	patch_code(ctx,op_pos[n],code[n] | I_Type(offset,0,0,0,0)); break;
+					case TYPE_B:	patch_code(ctx,op_pos[n],code[n] | B_Type(offset,0,0,0,0)); break;
+					case TYPE_S:	patch_code(ctx,op_pos[n],code[n] | S_Type(offset,0,0,0,0)); break;
+					case TYPE_J:	patch_code(ctx,op_pos[n],code[n] | J_Type(offset,0,0)); break;
+					case TYPE_U:	patch_code(ctx,op_pos[n],code[n] | U_Type(offset,0,0)); break;
+				}
+				continue;
+			}
+			op_pos[kept] = op_pos[n];
+			label_pos[kept] = label_pos[n];
+			code[kept] = code[n];
+			if(ctx->streamed)
+			{
+				line[kept] = line[n];
+			}
+			kept++;
+		}
+		fixups->count = kept;
+		fixups->op_pos.size = fixups->label_pos.size = fixups->code.size = kept * sizeof(uint32_t);
+		if(ctx->streamed)
+		{
+			fixups->line.size = kept * sizeof(uint32_t);
+		}
+	}
+}
+
+// second pass, parse and encode the chunk into its own context
+void* chunk_parse(void *arg)
+{
+	Chunk *chunk = arg;
+	Basm_Context *ctx = calloc(1,sizeof(Basm_Context));
+	chunk->ctx = ctx;
+	if(ctx == NULL)
+	{
+		chunk->failed = TRUE;
+		return NULL;
+	}
+	init_context(ctx,chunk->start,chunk->end,&chunk->out);
+	ctx->source_line_number = chunk->first_line;
+	ctx->keep_warnings = chunk->keep_warnings;
+	if( !run_chunk(chunk) )
+	{
+		chunk->failed = TRUE;
+		return NULL;
+	}
+	resolve_reached_fixups(ctx);
+	return NULL;
+}
+
+// runs work on every chunk, the calling thread takes chunk 0
+int run_chunks(Chunk *chunks,int chunk_count,void* (*work)(void*))
+{
+	pthread_t threads[CHUNK_MAX];
+	int started[CHUNK_MAX];
+	for(int i=1;i<chunk_count;i++)
+	{
+		started[i] = ( pthread_create(&threads[i],NULL,work,&chunks[i]) == 0 );
+		if(!started[i])
+		{
+			work(&chunks[i]);
+		}
+	}
+	work(&chunks[0]);
+	int failed = chunks[0].failed;
+	for(int i=1;i<chunk_count;i++)
+	{
+		if(started[i])
+		{
+			pthread_join(threads[i],NULL);
+		}
+		failed |= chunks[i].failed;
+	}
+	return !failed;
+}
+
+// reads the const lines of every chunk in source order
+void read_chunk_consts(Basm_Context *ctx,Chunk *chunks,int chunk_count)
+{
+	for(int i=0;i<chunk_count;i++)
+	{
+		chunks[i].const_seed = ctx->const_buffer.size;
+		chunks[i].consts = &ctx->const_buffer;
+		for(uint32_t n=0;n<chunks[i].const_lines.size;n+=sizeof(uint32_t))
+		{
+			uint32_t offset;
+			copy_buffer(&chunks[i].const_lines.data[n],&offset,sizeof(uint32_t));
+			ctx->source_ptr = chunks[i].start + offset + 1;
+			ctx->new_char = AT_SIGN;
+			parse_Const(ctx);
+		}
+	}
+}
+
+// joins the chunk images and labels into ctx and moves every saved op over
+void merge_chunks(Basm_Context *ctx,Chunk *chunks,int chunk_count)
+{
+	// file_finish() warns on the last line, where a single pass would be
+	ctx->source_line_number = chunks[chunk_count-1].first_line + chunks[chunk_count-1].line_count;
+	uint32_t size = 0;
+	for(int i=0;i<chunk_count;i++)
+	{
+		size += chunks[i].ctx->output_code.size;
+	}
+	uint32_t offset = context_alloc(ctx,&ctx->output_code,size);
+	for(int i=0;i<chunk_count;i++)
+	{
+		Arena *code = &chunks[i].ctx->output_code;
+		copy_buffer(code->data,&ctx->output_code.data[offset],code->size);
+		offset += code->size;
+	}
+
+	// every label a chunk reached, add_label() catches duplicates
+	for(int i=0;i<chunk_count;i++)
+	{
+		Arena *labels = &chunks[i].ctx->label_buffer;
+		for(uint32_t pos=0;pos<labels->size;pos+=labels->data[pos]+LABEL_HEADER)
+		{
+			copy_buffer(&labels->data[pos+1],&ctx->output_code_position,OP_CODE_SIZE);
+			if(ctx->output_code_position == LABEL_UNDEFINED)
+			{
+				continue;
+			}
+			ctx->output_code_position += chunks[i].base_address;
+			ctx->token = &labels->data[pos+LABEL_HEADER];
+			ctx->token_length = labels->data[pos];
+			add_label(ctx);
+		}
+	}
+	ctx->output_code_position = size;
+
+	// point saved ops at the merged labels, missing ones are left undefined for file_finish()
+	for(int i=0;i<chunk_count;i++)
+	{
+		Arena *labels = &chunks[i].ctx->label_buffer;
+		for(int type=0;type<NUMBER_OF_TYPES;type++)
+		{
+			Fixups *fixups = &chunks[i].ctx->fixups[type];
+			uint32_t *op_pos = (uint32_t*)fixups->op_pos.data;
+			uint32_t *label_pos = (uint32_t*)fixups->label_pos.data;
+			uint32_t *code = (uint32_t*)fixups->code.data;
+			for(uint32_t n=0;n<fixups->count;n++)
+			{
+				uint32_t pos = label_pos[n] - 1;
+				ctx->token = &labels->data[pos+LABEL_HEADER];
+				ctx->token_length = labels->data[pos];
+				uint32_t hash = hash_name(ctx->token,ctx->token_length);
+				if( !find_label(ctx,hash) )
+				{
+					new_label(ctx,hash,LABEL_UNDEFINED);
+				}
+				add_fixup(ctx,type,chunks[i].base_address + op_pos[n],ctx->label_buffer_position + 1,code[n]);
+			}
+		}
+	}
+}
+
+// line number and base address of every scanned chunk, FALSE if the image is too big
+int chunk_layout(Chunk *chunks,int chunk_count)
+{
+	uint32_t line = 0;
+	uint32_t address = 0;
+	for(int i=0;i<chunk_count;i++)
+	{
+		chunks[i].first_line = line;
+		chunks[i].base_address = address;
+		line += chunks[i].line_count;
+		if( (uint64_t)address + chunks[i].byte_count > ARENA_MAX_SIZE )
+		{
+			return FALSE;
+		}
+		address += chunks[i].byte_count;
+	}
+	return TRUE;
+}
+
+int run_parallel(Basm_Context *ctx,Chunk *chunks,int chunk_count)
+{
+	if( setjmp(ctx->error_jump) )
+	{
+		return FALSE;
+	}
+	if( !run_chunks(chunks,chunk_count,chunk_scan) || !chunk_layout(chunks,chunk_count) )
+	{
+		return FALSE;
+	}
+	ctx->source_end = chunks[chunk_count-1].end;
+	read_chunk_consts(ctx,chunks,chunk_count);
+	if( !run_chunks(chunks,chunk_count,chunk_parse) )
+	{
+		return FALSE;
+	}
+	merge_chunks(ctx,chunks,chunk_count);
+	file_finish(ctx);
+	return TRUE;
+}
+
+int basm_assemble_threads(const char *src,size_t len,int threads,basm_output *out)
+{
+	return assemble_threads_dir(src,len,threads,NULL,out);
+}
+
+// basm_assemble_threads() with $f paths read from dir, see basm_assemble_dir().
+// Chunks never read a file, a source with $f falls back to one pass.
+int assemble_threads_dir(const char *src,size_t len,int threads,const char *dir,basm_output *out)
+{
+	int chunk_count = (len / CHUNK_MIN_SIZE < (size_t)threads) ? (int)(len / CHUNK_MIN_SIZE) : threads;
+	if(chunk_count > CHUNK_MAX)
+	{
+		chunk_count = CHUNK_MAX;
+	}
+	if(chunk_count < 2)
+	{
+		return basm_assemble_dir(src,len,0,dir,out,NULL);
+	}
+	Chunk *chunks = calloc(chunk_count,sizeof(Chunk));
+	Basm_Context *ctx = calloc(1,sizeof(Basm_Context));
+	out->data = NULL;
+	out->size = 0;
+	out->error_line = 0;
+	out->error[0] = 0;
+	out->messages = NULL;
+	if( (chunks == NULL) || (ctx == NULL) )
+	{
+		free(chunks);
+		free(ctx);
+		return basm_assemble_dir(src,len,0,dir,out,NULL);
+	}
+
+	// split after a line end near every 1/chunk_count of the source
+	const uint8_t *source = (const uint8_t*)src;
+	const uint8_t *start = source;
+	int used = 0;
+	for(int i=1;i<=chunk_count;i++)
+	{
+		const uint8_t *end = source + len;
+		if(i < chunk_count)
+		{
+			const uint8_t *split = source + (len / chunk_count) * i;
+			if(split < start)
+			{
+				continue;
+			}
+			const uint8_t *line_end = memchr(split,LINE_END,(source + len) - split);
+			if(line_end == NULL)
+			{
+				continue;
+			}
+			end = line_end + 1;
+		}
+		chunks[used].start = start;
+		chunks[used].end = end;
+		used++;
+		start = end;
+	}
+	init_context(ctx,source,source + len,out);
+
+	int assembled = run_parallel(ctx,chunks,used);
+	if(assembled)
+	{
+		out->data = ctx->output_code.data;
+		out->size = ctx->output_code.size;
+		ctx->output_code.data = NULL;
+	}
+	for(int i=0;i<used;i++)
+	{
+		arena_free(&chunks[i].const_lines);
+		if(chunks[i].ctx != NULL)
+		{
+			free_context(chunks[i].ctx);
+			free(chunks[i].ctx);
+		}
+	}
+	free_context(ctx);
+	free(ctx);
+	free(chunks);
+	if(!assembled)
+	{
+		// run it again in one pass for the error and its line
+		return basm_assemble_dir(src,len,0,dir,out,NULL);
+	}
+	return 0;
+}
+
+// -------- Region Cache ---------------------------------
+// basm_assemble_cached() keeps what every region of the last source made, the
+// code, labels, saved ops and warnings, so a rebuild only parses the regions
+// that changed and still prints every warning. A region starts at a label line whose name hashes to 0 in the
+// REGION_LABEL_MASK bits, so where regions start depends only on the text
+// near them and an edit changes just the regions it touches. Regions are
+// parsed as chunks at address 0, merge_chunks() moves them to where they land.
+// A region is keyed by a hash of its text and of the consts defined above it.
+// Sources the chunk scan can not split ($f lines) are assembled in one pass.
+
+#define REGION_LABEL_MASK	63	// about one label line in 64 starts a region
+#define REGION_HASH_SEED	0x9e3779b97f4a7c15ull
+#define REGION_HASH_K1		0x87c37b91114253d5ull
+#define REGION_HASH_K2		0x4cf5ad432745937full
+
+#define REGION_FREE			0
+#define REGION_NEW			1	// parsed for this source
+#define REGION_KEPT			2	// taken from the cache
+
+typedef struct Region_Entry
+{
+	uint64_t		key;
+	uint32_t		length;		// bytes of region text
+	uint32_t		chunk;		// first chunk with the region, it parses a new one
+	uint32_t		first_line;	// source line the region started on when it was parsed
+	Basm_Context*	ctx;		// the parsed region, NULL until parsed
+	uint8_t			state;
+	uint8_t			used;		// in the cache, taken by the source being assembled
+}Region_Entry;
+
+struct basm_cache
+{
+	Region_Entry*	entries;	// open addressing on key
+	uint32_t		size;		// slots, a power of two
+};
+
+// 64 bit hash of size bytes continued from hash, eight bytes a step
+uint64_t region_hash(uint64_t hash,const uint8_t *data,size_t size)
+{
+	uint64_t word;
+	for(;size >= 8;data += 8,size -= 8)
+	{
+		memcpy(&word,data,8);
+		word *= REGION_HASH_K1;
+		hash ^= (word << 31) | (word >> 33);
+		hash = ( (hash << 27) | (hash >> 37) ) * REGION_HASH_K2 + 0x52dce729;
+	}
+	word = 0;
+	memcpy(&word,data,size);
+	hash ^= (word * REGION_HASH_K1) ^ size;
+	hash ^= hash >> 33;
+	hash *= REGION_HASH_K2;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+// slot of key, or the free slot it would go in
+Region_Entry* region_find(Region_Entry *entries,uint32_t size,uint64_t key,uint32_t length)
+{
+	uint32_t slot = (uint32_t)key & (size - 1);
+	while(entries[slot].state != REGION_FREE)
+	{
+		if( (entries[slot].key == key) && (entries[slot].length == length) )
+		{
+			break;
+		}
+		slot = (slot + 1) & (size - 1);
+	}
+	return &entries[slot];
+}
+
+// adds a chunk for the region from start to end, FALSE if out of memory
+int region_add(Arena *regions,const uint8_t *start,const uint8_t *end)
+{
+	if( !arena_reserve(regions,sizeof(Chunk)) )
+	{
+		return FALSE;
+	}
+	Chunk *chunk = (Chunk*)&regions->data[regions->size];
+	zero_buffer(chunk,sizeof(Chunk));
+	chunk->start = start;
+	chunk->end = end;
+	regions->size += sizeof(Chunk);
+	return TRUE;
+}
+
+// splits the source into regions, a Chunk each, FALSE if out of memory.
+// Only colons are looked for, one with nothing but blanks before it on its
+// line starts a label.
+int region_split(const uint8_t *source,size_t len,Arena *regions)
+{
+	const uint8_t *end = source + len;
+	const uint8_t *start = source;
+	const uint8_t *ptr = source;
+	while( (ptr = memchr(ptr,COLON,end - ptr)) != NULL )
+	{
+		const uint8_t *line = ptr;
+		while( (line > source) && CHAR_IS(line[-1],CHAR_BLANK) )
+		{
+			line--;
+		}
+		if( ( (line == source) || (line[-1] == LINE_END) ) && (line != start) )
+		{
+			const uint8_t *name_end = scan_name(ptr + 1,end);
+			if( ( (hash_name((CHAR_PTR)ptr + 1,name_end - ptr - 1) >> 24) & REGION_LABEL_MASK ) == 0 )
+			{
+				if( !region_add(regions,start,line) )
+				{
+					return FALSE;
+				}
+				start = line;
+			}
+		}
+		ptr = scan_line_end(ptr + 1,end);
+	}
+	return region_add(regions,start,end);
+}
+
+// frees the entries and the regions they hold in state, REGION_FREE for all
+void region_free(Region_Entry *entries,uint32_t size,int state)
+{
+	for(uint32_t i=0;i<(entries ? size : 0);i++)
+	{
+		if( (entries[i].ctx != NULL) && !entries[i].used && ( (state == REGION_FREE) || (entries[i].state == state) ) )
+		{
+			free_context(entries[i].ctx);
+			free(entries[i].ctx);
+		}
+	}
+	free(entries);
+}
+
+// keeps only what merge_chunks() reads
+void region_trim(Basm_Context *ctx)
+{
+	arena_free(&ctx->const_buffer);
+	arena_free(&ctx->fixup_offsets);
+	free(ctx->label_index);
+	ctx->label_index = NULL;
+	ctx->label_index_size = 0;
+	free(ctx->const_index);
+	ctx->const_index = NULL;
+	ctx->const_index_size = 0;
+	ctx->out = NULL;
+}
+
+// parses the regions that are not in the cache and merges them all into ctx,
+// slots[i] is set to the entry of chunk i in entries
+int run_cached(Basm_Context *ctx,basm_cache *cache,Chunk *chunks,int chunk_count,Region_Entry **slots,Region_Entry *entries,uint32_t size)
+{
+	if( setjmp(ctx->error_jump) )
+	{
+		return FALSE;
+	}
+	for(int i=0;i<chunk_count;i++)
+	{
+		chunk_scan(&chunks[i]);
+		if(chunks[i].failed)
+		{
+			return FALSE;
+		}
+	}
+	if( !chunk_layout(chunks,chunk_count) )
+	{
+		return FALSE;
+	}
+	ctx->source_end = chunks[chunk_count-1].end;
+	read_chunk_consts(ctx,chunks,chunk_count);
+
+	uint64_t consts = REGION_HASH_SEED;
+	uint32_t hashed = 0;
+	for(int i=0;i<chunk_count;i++)
+	{
+		if(chunks[i].const_seed > hashed)
+		{
+			consts = region_hash(consts,&ctx->const_buffer.data[hashed],chunks[i].const_seed - hashed);
+			hashed = chunks[i].const_seed;
+		}
+		uint32_t length = chunks[i].end - chunks[i].start;
+		uint64_t key = region_hash(consts,chunks[i].start,length);
+		Region_Entry *entry = region_find(entries,size,key,length);
+		if(entry->state == REGION_FREE)
+		{
+			entry->key = key;
+			entry->length = length;
+			entry->chunk = i;
+			entry->state = REGION_NEW;
+			Region_Entry *cached = cache->entries ? region_find(cache->entries,cache->size,key,length) : NULL;
+			if( (cached != NULL) && (cached->state != REGION_FREE) )
+			{
+				entry->ctx = cached->ctx;
+				entry->first_line = cached->first_line;
+				entry->state = REGION_KEPT;
+				cached->used = TRUE;
+			}
+		}
+		slots[i] = entry;
+	}
+
+	for(int i=0;i<chunk_count;i++)
+	{
+		Region_Entry *entry = slots[i];
+		if( (entry->state == REGION_NEW) && (entry->chunk == (uint32_t)i) )
+		{
+			chunks[i].keep_warnings = TRUE;
+			chunk_parse(&chunks[i]);
+			entry->ctx = chunks[i].ctx;
+			entry->first_line = chunks[i].first_line;
+			if(chunks[i].failed)
+			{
+				return FALSE;
+			}
+			region_trim(entry->ctx);
+		}
+		chunks[i].ctx = entry->ctx;
+	}
+	merge_chunks(ctx,chunks,chunk_count);
+	// every region's warnings in source order, moved to where the region is now
+	for(int i=0;i<chunk_count;i++)
+	{
+		Region_Entry *entry = slots[i];
+		Warning *warnings = (Warning*)entry->ctx->warnings.data;
+		for(uint32_t n=0;n<entry->ctx->warnings.size/sizeof(Warning);n++)
+		{
+			context_print(ctx,warnings[n].message,warnings[n].line - entry->first_line + chunks[i].first_line);
+		}
+	}
+	file_finish(ctx);
+	return TRUE;
+}
+
+basm_cache* basm_cache_new(void)
+{
+	return calloc(1,sizeof(basm_cache));
+}
+
+void basm_cache_free(basm_cache *cache)
+{
+	if(cache != NULL)
+	{
+		region_free(cache->entries,cache->size,REGION_FREE);
+		free(cache);
+	}
+}
+
+int basm_assemble_cached(basm_cache *cache,const char *src,size_t len,basm_output *out)
+{
+	return basm_assemble_cached_flags(cache,src,len,0,out);
+}
+
+int basm_assemble_cached_flags(basm_cache *cache,const char *src,size_t len,int flags,basm_output *out)
+{
+	const uint8_t *source = (const uint8_t*)src;
+	// regions are parsed as flat code at address 0, -c and --relax sizes depend on where they land
+	if( (cache == NULL) || (len == 0) || (len > ARENA_MAX_SIZE) || ( flags & (BASM_COMPRESS | BASM_RELAX) ) )
+	{
+		return basm_assemble_flags(src,len,flags,out,NULL);
+	}
+	out->data = NULL;
+	out->size = 0;
+	out->error_line = 0;
+	out->error[0] = 0;
+	out->messages = NULL;
+	Arena regions = {0};
+	Chunk *chunks = NULL;
+	int chunk_count = 0;
+	uint32_t size = 16;
+	Region_Entry **slots = NULL;
+	Region_Entry *entries = NULL;
+	Basm_Context *ctx = NULL;
+	if( region_split(source,len,&regions) )
+	{
+		chunks = (Chunk*)regions.data;
+		chunk_count = regions.size / sizeof(Chunk);
+		while(size < (uint32_t)chunk_count * 2)
+		{
+			size *= 2;
+		}
+		slots = calloc(chunk_count,sizeof(Region_Entry*));
+		entries = calloc(size,sizeof(Region_Entry));
+		ctx = calloc(1,sizeof(Basm_Context));
+	}
+	int assembled = FALSE;
+	if( (slots != NULL) && (entries != NULL) && (ctx != NULL) )
+	{
+		init_context(ctx,source,source + len,out);
+		ctx->keep_messages = (flags & BASM_KEEP_MESSAGES) != 0;
+		assembled = run_cached(ctx,cache,chunks,chunk_count,slots,entries,size);
+	}
+	if(assembled)
+	{
+		out->data = ctx->output_code.data;
+		out->size = ctx->output_code.size;
+		ctx->output_code.data = NULL;
+		if(ctx->messages.size != 0)
+		{
+			out->messages = (char*)ctx->messages.data;
+			ctx->messages.data = NULL;
+		}
+		// regions the source no longer has go, the rest are now held by entries
+		region_free(cache->entries,cache->size,REGION_FREE);
+		cache->entries = entries;
+		cache->size = size;
+	}
+	else
+	{
+		// the cache is left as it was, regions parsed for this source go
+		for(uint32_t i=0;i<(cache->entries ? cache->size : 0);i++)
+		{
+			cache->entries[i].used = FALSE;
+		}
+		region_free(entries,size,REGION_NEW);
+	}
+	for(int i=0;i<chunk_count;i++)
+	{
+		arena_free(&chunks[i].const_lines);
+	}
+	arena_free(&regions);
+	if(ctx != NULL)
+	{
+		free_context(ctx);
+		free(ctx);
+	}
+	free(slots);
+	if(!assembled)
+	{
+		// run it again in one pass for the error and its line
+		return basm_assemble_flags(src,len,flags,out,NULL);
+	}
+	return 0;
+}
+
+// -------- Streaming ------------------------------------
+// basm_assemble_stream() reads the source a block at a time and parses the
+// whole lines in it. After each block the saved ops whose label has been
+// reached are filled in, and the image up to the first op still waiting for
+// a label is written out and dropped, so memory holds the labels and only
+// the part of the image a forward reference points into.
+//
+// With BASM_PIPELINE reading and writing run on threads of their own. The
+// reader fills source blocks and the writer empties image blocks, each
+// passed over a Ring and handed back empty over another, so the parser
+// never waits on I/O while there are blocks ready.
+//
+//	reader -> blocks -> parser -> writes -> writer
+//	reader <- free_blocks <- parser <- free_writes <- writer
+
+#define STREAM_READ_SIZE	(1<<16)	// source bytes read at a time
+#define STREAM_BLOCKS		4		// blocks in flight between each pair of stages, at most RING_SIZE
+#define STREAM_RINGS		4
+
+typedef struct Stream_Block
+{
+	Arena		bytes;
+	int			last;		// nothing follows this block
+	int			failed;		// reading it failed
+}Stream_Block;
+
+typedef struct Stream
+{
+	FILE*			input;
+	FILE*			output;
+	int				pipelined;
+	Stream_Block	block;		// the source block when not pipelined
+	Arena			carry;		// read after the last line end, starts the next block
+	Stream_Block	pool[STREAM_BLOCKS*2];
+	Ring			blocks;
+	Ring			free_blocks;
+	Ring			writes;
+	Ring			free_writes;
+	int				rings_ready;	// the rings were set up by stream_rings_init()
+	int				written;	// the last block went to the writer
+	atomic_int		stop;		// the parser is done, the reader stops
+	atomic_int		write_failed;
+}Stream;
+
+// reads whole lines into block, what follows the last line end is kept in
+// carry for the next one. FALSE on a read error or out of memory.
+int stream_fill(FILE *input,Stream_Block *block,Arena *carry)
+{
+	block->bytes.size = 0;
+	if( !arena_reserve(&block->bytes,carry->size) )
+	{
+		return FALSE;
+	}
+	memcpy(block->bytes.data,carry->data,carry->size);
+	block->bytes.size = carry->size;
+	carry->size = 0;
+	while(TRUE)
+	{
+		if( !arena_reserve(&block->bytes,STREAM_READ_SIZE) )
+		{
+			return FALSE;
+		}
+		uint32_t start = block->bytes.size;
+		size_t got = fread(&block->bytes.data[start],1,STREAM_READ_SIZE,input);
+		if(got == 0)
+		{
+			block->last = TRUE;
+			return !ferror(input);
+		}
+		block->bytes.size += got;
+		uint32_t lines = block->bytes.size;
+		while( (lines > start) && (block->bytes.data[lines-1] != LINE_END) )
+		{
+			lines--;
+		}
+		if(lines > start)
+		{
+			uint32_t rest = block->bytes.size - lines;
+			if( !arena_reserve(carry,rest) )
+			{
+				return FALSE;
+			}
+			memcpy(carry->data,&block->bytes.data[lines],rest);
+			carry->size = rest;
+			block->bytes.size = lines;
+			return TRUE;
+		}
+	}
+}
+
+// FALSE if the rings could not be set up, none are left set up then
+int stream_rings_init(Stream *stream)
+{
+	Ring *rings[STREAM_RINGS] = { &stream->blocks, &stream->free_blocks, &stream->writes, &stream->free_writes };
+	for(int i=0;i<STREAM_RINGS;i++)
+	{
+		if( !ring_init(rings[i]) )
+		{
+			while(i-- > 0)
+			{
+				ring_free(rings[i]);
+			}
+			return FALSE;
+		}
+	}
+	stream->rings_ready = TRUE;
+	return TRUE;
+}
+
+void stream_rings_free(Stream *stream)
+{
+	if(stream->rings_ready)
+	{
+		ring_free(&stream->blocks);
+		ring_free(&stream->free_blocks);
+		ring_free(&stream->writes);
+		ring_free(&stream->free_writes);
+	}
+}
+
+void* stream_reader(void *arg)
+{
+	Stream *stream = arg;
+	int done;
+	do
+	{
+		Stream_Block *block = ring_pop_wait(&stream->free_blocks,&stream->stop);
+		if(block == NULL)
+		{
+			return NULL;
+		}
+		block->failed = !stream_fill(stream->input,block,&stream->carry);
+		done = block->last || block->failed;
+		ring_push_wait(&stream->blocks,block);
+	}while(!done);
+	return NULL;
+}
+
+void* stream_writer(void *arg)
+{
+	Stream *stream = arg;
+	int last;
+	do
+	{
+		Stream_Block *block = ring_pop_wait(&stream->writes,NULL);
+		// after a failed write the rest are only handed back
+		if( !atomic_load(&stream->write_failed) && !put_code(stream->output,block->bytes.data,block->bytes.size) )
+		{
+			atomic_store(&stream->write_failed,TRUE);
+		}
+		last = block->last;
+		ring_push_wait(&stream->free_writes,block);
+	}while(!last);
+	return NULL;
+}
+
+// the next block of whole source lines
+Stream_Block* stream_next(Basm_Context *ctx,Stream *stream)
+{
+	Stream_Block *block = &stream->block;
+	if(stream->pipelined)
+	{
+		block = ring_pop_wait(&stream->blocks,NULL);
+	}
+	else
+	{
+		block->failed = !stream_fill(stream->input,block,&stream->carry);
+	}
+	if(block->failed)
+	{
+		assemble_error(ctx,"\n Error reading file",-1);
+	}
+	return block;
+}
+
+void stream_write(Basm_Context *ctx,Stream *stream,const uint8_t *data,uint32_t size,int last)
+{
+	if(!stream->pipelined)
+	{
+		if( !put_code(stream->output,data,size) )
+		{
+			assemble_error(ctx,"\n Error writing file",-1);
+		}
+		return;
+	}
+	if( atomic_load(&stream->write_failed) )
+	{
+		assemble_error(ctx,"\n Error writing file",-1);
+	}
+	Stream_Block *block = ring_pop_wait(&stream->free_writes,NULL);
+	block->bytes.size = 0;
+	block->last = last;
+	if( !arena_reserve(&block->bytes,size) )
+	{
+		// the writer still needs to see a last block
+		block->last = TRUE;
+		ring_push_wait(&stream->writes,block);
+		stream->written = TRUE;
+		assemble_error(ctx,"Error Out of memory ",-1);
+	}
+	memcpy(block->bytes.data,data,size);
+	block->bytes.size = size;
+	ring_push_wait(&stream->writes,block);
+	stream->written = last;
+}
+
+// writes the image up to position keep and drops it from output_code
+void stream_flush(Basm_Context *ctx,Stream *stream,uint32_t keep,int last)
+{
+	uint32_t bytes = keep - ctx->output_flushed;
+	stream_write(ctx,stream,ctx->output_code.data,bytes,last);
+	memmove(ctx->output_code.data,&ctx->output_code.data[bytes],ctx->output_code.size - bytes);
+	ctx->output_code.size -= bytes;
+	ctx->output_flushed = keep;
+}
+
+// image position of the first op still waiting for a label
+uint32_t stream_pending(Basm_Context *ctx)
+{
+	uint32_t first = ctx->output_code_position;
+	for(int type=TYPE_I;type<NUMBER_OF_TYPES;type++)
+	{
+		// each type is saved in op order, the first one is the lowest
+		if( (ctx->fixups[type].count != 0) && (((uint32_t*)ctx->fixups[type].op_pos.data)[0] < first) )
+		{
+			first = ((uint32_t*)ctx->fixups[type].op_pos.data)[0];
+		}
+	}
+	return first;
+}
+
+int run_stream(Basm_Context *ctx,Stream *stream)
+{
+	if( setjmp(ctx->error_jump) )
+	{
+		return FALSE;
+	}
+	int last;
+	do
+	{
+		Stream_Block *block = stream_next(ctx,stream);
+		ctx->source_ptr = block->bytes.data;
+		ctx->source_end = block->bytes.data + block->bytes.size;
+		ctx->new_char = SPACE;
+		ctx->reached_end_of_file = FALSE;
+		start_parser(ctx);
+		last = block->last;
+		if(stream->pipelined)
+		{
+			ring_push_wait(&stream->free_blocks,block);	// the reader owns it from here
+		}
+		if(!last)
+		{
+			resolve_reached_fixups(ctx);
+			stream_flush(ctx,stream,stream_pending(ctx),FALSE);
+		}
+	}while(!last);
+	file_finish(ctx);
+	stream_flush(ctx,stream,ctx->output_code_position,TRUE);
+	return TRUE;
+}
+
+int basm_assemble_stream(FILE *input,FILE *output,int flags,basm_output *out)
+{
+	return assemble_stream_dir(input,output,flags,NULL,out);
+}
+
+// basm_assemble_stream() with $f paths read from dir, see basm_assemble_dir()
+int assemble_stream_dir(FILE *input,FILE *output,int flags,const char *dir,basm_output *out)
+{
+	Basm_Context *ctx = new_context(NULL,0,out);
+	Stream *stream = calloc(1,sizeof(Stream));
+	if( (ctx == NULL) || (stream == NULL) )
+	{
+		snprintf(out->error,BASM_ERROR_SIZE,"%s","Error Out of memory ");
+		free(ctx);
+		free(stream);
+		return -1;
+	}
+	ctx->compress = (flags & BASM_COMPRESS) != 0;
+	ctx->no_data_files = (flags & BASM_NO_DATA_FILES) != 0;
+	ctx->data_dir = dir;
+	ctx->streamed = TRUE;
+	stream->input = input;
+	stream->output = output;
+
+	pthread_t reader;
+	pthread_t writer;
+	int pipelined = FALSE;
+	if( (flags & BASM_PIPELINE) && stream_rings_init(stream) )
+	{
+		for(int i=0;i<STREAM_BLOCKS;i++)
+		{
+			ring_push(&stream->free_blocks,&stream->pool[i]);
+			ring_push(&stream->free_writes,&stream->pool[STREAM_BLOCKS + i]);
+		}
+		if(pthread_create(&writer,NULL,stream_writer,stream) == 0)
+		{
+			pipelined = (pthread_create(&reader,NULL,stream_reader,stream) == 0);
+			if(!pipelined)
+			{
+				Stream_Block *block = ring_pop(&stream->free_writes);
+				block->last = TRUE;
+				ring_push(&stream->writes,block);
+				pthread_join(writer,NULL);
+			}
+		}
+	}
+	stream->pipelined = pipelined;
+
+	int assembled = run_stream(ctx,stream);
+	if(stream->pipelined)
+	{
+		atomic_store(&stream->stop,TRUE);
+		ring_wake(&stream->free_blocks);	// the reader may sleep on it
+		pthread_join(reader,NULL);
+		if(!stream->written)
+		{
+			// stopped by an error before the last write, the writer still waits for it
+			Stream_Block *block = ring_pop_wait(&stream->free_writes,NULL);
+			block->bytes.size = 0;
+			block->last = TRUE;
+			ring_push_wait(&stream->writes,block);
+		}
+		pthread_join(writer,NULL);
+		if( assembled && atomic_load(&stream->write_failed) )
+		{
+			snprintf(out->error,BASM_ERROR_SIZE,"%s","\n Error writing file");
+			out->error_line = 0;
+			assembled = FALSE;
+		}
+	}
+	out->size = ctx->output_flushed;
+	arena_free(&stream->block.bytes);
+	arena_free(&stream->carry);
+	for(int i=0;i<STREAM_BLOCKS*2;i++)
+	{
+		arena_free(&stream->pool[i].bytes);
+	}
+	stream_rings_free(stream);
+	free(stream);
+	free_context(ctx);
+	free(ctx);
+	return assembled ? 0 : -1;
+}
+
+// -------- main() --------------------------------------
+
+#ifndef BASM_LIBRARY
+int main( int argc, char *argv[] ) 
+{
+
+	if( (argc > 3) && (strcmp(argv[1],"-j") == 0) )
+	{
+		// basm_rv -j N a.s b.s ...
+		int thread_count = atoi(argv[2]);
+		if(thread_count < 1)
+		{
+			print_error("\n basm_riscv -j [threads] [source_file_name] ...",-1);
+			exit(-1);
+		}
+		if( batch_assemble(&argv[3],argc - 3,thread_count) )
+		{
+			exit(-1);
+		}
+		return 0;
+	}
+	if( (argc == 3 || argc == 4) && (strcmp(argv[1],"--serve") == 0) )
+	{
+		// basm_rv --serve socket_path [threads], runs until killed
+		int thread_count = (argc == 4) ? atoi(argv[3]) : 1;
+		if(thread_count < 1)
+		{
+			print_error("\n basm_riscv --serve socket_path [threads]",-1);
+			exit(-1);
+		}
+		serve(argv[2],thread_count);
+		exit(-1);
+	}
+
+	int threads = 1;
+	int show_stats = FALSE;
+	int flags = 0;	// flat binary, no compressed ops
+	char *client_socket = NULL;
+	while( (argc > 3) && (argv[1][0] == '-') )
+	{
+		if(strcmp(argv[1],"-t") == 0)
+		{
+			// basm_rv -t N source binary, split one source over N threads
+			threads = atoi(argv[2]);
+			argc -= 2;
+			argv += 2;
+		}
+		else if(strcmp(argv[1],"--stats") == 0)
+		{
+			// JSON timings and counts to stderr, always a single pass
+			show_stats = TRUE;
+			argc--;
+			argv++;
+		}
+		else if(strcmp(argv[1],"--elf") == 0)
+		{
+			// ELF relocatable object instead of a flat binary
+			flags = (flags & ~BASM_ELF_EXECUTABLE) | BASM_ELF_RELOCATABLE;
+			argc--;
+			argv++;
+		}
+		else if(strcmp(argv[1],"--elf-exec") == 0)
+		{
+			flags = (flags & ~BASM_ELF_RELOCATABLE) | BASM_ELF_EXECUTABLE;
+			argc--;
+			argv++;
+		}
+		else if(strcmp(argv[1],"--pipeline") == 0)
+		{
+			// read, assemble and write on three threads
+			flags |= BASM_PIPELINE;
+			argc--;
+			argv++;
+		}
+		else if(strcmp(argv[1],"--relax") == 0)
+		{
+			flags |= BASM_RELAX;
+			argc--;
+			argv++;
+		}
+		else if(strcmp(argv[1],"--relax-scratch") == 0)
+		{
+			// --relax-scratch xN, far branches may clobber xN
+			int reg = (argv[2][0] == 'x') ? atoi(&argv[2][1]) : 0;
+			if( (reg < 1) || (reg > 31) )
+			{
+				print_error("\n Error --relax-scratch takes a register x1 - x31",-1);
+				exit(-1);
+			}
+			flags = (flags & ~BASM_RELAX_SCRATCH_MASK) | BASM_RELAX | BASM_RELAX_SCRATCH(reg);
+			argc -= 2;
+			argv += 2;
+		}
+		else if(strcmp(argv[1],"--client") == 0)
+		{
+			// the daemon started with --serve does the work
+			client_socket = argv[2];
+			argc -= 2;
+			argv += 2;
+		}
+		else if(strcmp(argv[1],"-c") == 0)
+		{
+			// RVC, ops are not a fixed size so this is always a single pass
+			flags |= BASM_COMPRESS;
+			argc--;
+			argv++;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if( (argc != 3) || (threads < 1) )
+	{
+		// print help msg
+		print_error("\n basm_riscv [-t threads] [-c] [--relax] [--relax-scratch xN] [--pipeline] [--stats] [--elf | --elf-exec] [source_file_name | -] [binary_file_name | -]",-1);
+		print_error("\n basm_riscv -j [threads] [source_file_name] ...",-1);
+		print_error("\n basm_riscv --serve socket_path [threads]",-1);
+		print_error("\n basm_riscv --client socket_path [-c] [--relax] [--relax-scratch xN] [source_file_name | -] [binary_file_name | -]",-1);
+		exit(-1);
+	}
+
+	char *input_file = argv[1];
+	char *output_file = argv[2];
+	int from_stdin = (strcmp(input_file,"-") == 0);
+	int to_stdout = (strcmp(output_file,"-") == 0);
+	if(to_stdout)
+	{
+		// keep messages out of the binary
+		message_file = stderr;
+	}
+	if(client_socket != NULL)
+	{
+		if( serve_client(client_socket,input_file,output_file,flags) )
+		{
+			exit(-1);
+		}
+		print_error("\n Assembled with no Errors",-1);
+		return 0;
+	}
+
+	basm_output out;
+	basm_stats stats;
+	Source_File source;
+	char *data_dir = from_stdin ? NULL : source_dir(input_file);
+	FILE *output_file_ptr = to_stdout ? stdout : open_output(output_file);
+	if( ( from_stdin || (flags & BASM_PIPELINE) ) && !show_stats && !( flags & (BASM_ELF_RELOCATABLE | BASM_ELF_EXECUTABLE | BASM_RELAX) ) )
+	{
+		// the binary is written as the source comes in
+		FILE *input_file_ptr = from_stdin ? stdin : fopen(input_file,"rb");
+		if( (input_file_ptr == NULL) || (output_file_ptr == NULL) )
+		{
+			print_error("\n Error opening file",-1);
+			exit(-1);
+		}
+		if( assemble_stream_dir(input_file_ptr,output_file_ptr,flags,data_dir,&out) )
+		{
+			print_error(out.error,out.error_line - 1);
+			exit(-1);
+		}
+		fclose(input_file_ptr);
+		fclose(output_file_ptr);
+		free(data_dir);
+		print_error("\n Assembled with no Errors",-1);
+		return 0;
+	}
+	if( ( from_stdin ? !read_source(stdin,&source) : !load_source(input_file,&source) ) || (output_file_ptr == NULL) )
+	{
+		// May move this error to init_files to give info on which file errored. 
+		print_error("\n Error opening file",-1);
+		exit(-1);	
+	}
+
+	if( flags & (BASM_ELF_RELOCATABLE | BASM_ELF_EXECUTABLE) )
+	{
+		// the ELF writer streams to the file itself, always a single pass
+		if( assemble_elf_dir((const char*)source.data,source.size,flags,data_dir,output_file_ptr,&out) )
+		{
+			print_error(out.error,out.error_line - 1);
+			exit(-1);
+		}
+		fclose(output_file_ptr);
+		release_source(&source);
+		free(data_dir);
+		print_error("\n Assembled with no Errors",-1);
+		return 0;
+	}
+	int failed = (show_stats || flags) ?
+		basm_assemble_dir((const char*)source.data,source.size,flags,data_dir,&out,show_stats ? &stats : NULL) :
+		assemble_threads_dir((const char*)source.data,source.size,threads,data_dir,&out);
+	if(failed)
+	{
+		print_error(out.error,out.error_line - 1);
+		exit(-1);
+	}
+	double write_start = stats_now();
+	if( !put_code(output_file_ptr,out.data,out.size) )
+	{
+		print_error("\n Error writing file",-1);
+		exit(-1);
+	}
+	fclose(output_file_ptr);
+	if(show_stats)
+	{
+		stats.write_time = stats_now() - write_start;
+		basm_stats_json(&stats,stderr);
+	}
+	release_source(&source);
+	free(data_dir);
+	basm_output_free(&out);
+	print_error("\n Assembled with no Errors",-1);
+	return 0;	
+		
+}
+#endif
+
+void start_parser(Basm_Context *ctx)
+{
+	while(!ctx->reached_end_of_file)
+	{
+		parser_start_new_line(ctx);	
+	}
+	// load label values into opcodes
+}
+
+/*
+void parse_Const()			 // %0
+{
+	
+}
+*/
+// warnings for offsets that do not fit, all with the same line so only the count matters
+void offset_warnings(Basm_Context *ctx,uint32_t count)
+{
+	for(uint32_t i=0;i<count;i++)
 	{
-		clear_white_space();
+		context_print(ctx,"Error Offset out of scope",ctx->source_line_number);
 	}
 }
 
-
-void load_hex_to_tmp()
+// Offsets are worked out for every fixup of one type before any are encoded,
+// the encode loops have no branches so the compiler can vectorize them.
+uint32_t resolve_fixups(Basm_Context *ctx,uint8_t type,uint32_t *missing)
 {
-	int negative = 0;
-	tmp_token_buffer_length = 0;
-	//clear_white_space();
-
-	if(new_char == MINUS ) // handle negative number
-	{
-		tmp_token_buffer[tmp_token_buffer_length] = MINUS;
-		tmp_token_buffer_length++; // this work for zero indexed.
-		negative = 1;	
-		next_char();
-	}
-	
-	while( check_hex(new_char) )
+	Fixups *fixups = &ctx->fixups[type];
+	uint32_t count = fixups->count;
+	uint32_t out_of_range = 0;
+	uint32_t *restrict op_pos = (uint32_t*)fixups->op_pos.data;
+	uint32_t *restrict label_pos = (uint32_t*)fixups->label_pos.data;
+	uint32_t *restrict code = (uint32_t*)fixups->code.data;
+
+	arena_reset(&ctx->fixup_offsets);
+	context_alloc(ctx,&ctx->fixup_offsets,count*sizeof(int32_t));
+	int32_t *restrict offset = (int32_t*)ctx->fixup_offsets.data;
+
+	// gather label addresses, remember the first op with a missing label
+	for(uint32_t i=0;i<count;i++)
 	{
-		tmp_token_buffer[tmp_token_buffer_length] = new_char;
-		tmp_token_buffer_length++; // this work for zero indexed.
-		if(tmp_token_buffer_length> (MAX_HEX_LENGTH+negative) )
+		uint32_t label_addr;
+		copy_buffer(&ctx->label_buffer.data[label_pos[i]],&label_addr,OP_CODE_SIZE);
+		if( (label_addr == LABEL_UNDEFINED) && (op_pos[i] < *missing) )
 		{
-			// error out "Name to long in line" source_line_number
-			print_error(" Number is too long",source_line_number);
-			exit(-1);
+			*missing = op_pos[i];
 		}
-		next_char();
+		// a missing label leaves the offset zero for a relocation to fill in
+		offset[i] = (label_addr == LABEL_UNDEFINED) ? 0 : label_addr - op_pos[i];
 	}
-	if(tmp_token_buffer_length<(negative+1))// check if there was a number
+
+	switch(type)
 	{
-		print_error(" No number was entered",source_line_number);
-		exit(-1);
+		case TYPE_I:
+			for(uint32_t i=0;i<count;i++)
+			{
+				out_of_range += (offset[i] > SIGNED_12_BIT_MAX) | (offset[i] < SIGNED_12_BIT_MIN);
+				code[i] |= I_Type(offset[i],0,0,0,0);
+			}
+			break;
+		case TYPE_B:
+			for(uint32_t i=0;i<count;i++)
+			{
+				out_of_range += (offset[i] > SIGNED_12_BIT_MAX) | (offset[i] < SIGNED_12_BIT_MIN);
+				code[i] |= B_Type(offset[i],0,0,0,0);
+			}
+			break;
+		case TYPE_S:
+			for(uint32_t i=0;i<count;i++)
+			{
+				out_of_range += (offset[i] > SIGNED_12_BIT_MAX) | (offset[i] < SIGNED_12_BIT_MIN);
+				code[i] |= S_Type(offset[i],0,0,0,0);
+			}
+			break;
+		case TYPE_J:
+			for(uint32_t i=0;i<count;i++)
+			{
+				out_of_range += (offset[i] > SIGNED_20_BIT_MAX) | (offset[i] < SIGNED_20_BIT_MIN);
+				code[i] |= J_Type(offset[i],0,0);
+			}
+			break;
+		case TYPE_U:
+			for(uint32_t i=0;i<count;i++)
+			{
+				out_of_range += (offset[i] > SIGNED_20_BIT_MAX) | (offset[i] < SIGNED_20_BIT_MIN);
+				code[i] |= U_Type(offset[i],0,0);
+			}
+			break;
 	}
-	if( check_white_space(new_char) )
+
+	for(uint32_t i=0;i<count;i++)
 	{
-		clear_white_space();
+		patch_code(ctx,op_pos[i],code[i]);
 	}
-	
-	return;
+	return out_of_range;
 }
 
-void find_end_of_line()
+// out of range offsets in ops before the first missing label, the single pass order
+uint32_t count_offset_warnings(Basm_Context *ctx,uint32_t missing)
 {
-	if(new_char==LINE_END)
+	uint32_t count = 0;
+	for(int type=TYPE_I;type<NUMBER_OF_TYPES;type++)
 	{
-		return;
-	}
-	if( check_white_space(new_char) )
+		Fixups *fixups = &ctx->fixups[type];
+		uint32_t *op_pos = (uint32_t*)fixups->op_pos.data;
+		uint32_t *label_pos = (uint32_t*)fixups->label_pos.data;
+		int32_t max = ( (type == TYPE_J) || (type == TYPE_U) ) ? SIGNED_20_BIT_MAX : SIGNED_12_BIT_MAX;
+		int32_t min = ( (type == TYPE_J) || (type == TYPE_U) ) ? SIGNED_20_BIT_MIN : SIGNED_12_BIT_MIN;
+		for(uint32_t i=0;i<fixups->count;i++)
 		{
-			clear_white_space();
+			uint32_t label_addr;
+			copy_buffer(&ctx->label_buffer.data[label_pos[i]],&label_addr,OP_CODE_SIZE);
+			int32_t offset = label_addr - op_pos[i];
+			if( (op_pos[i] < missing) && ( (offset > max) || (offset < min) ) )
+			{
+				count++;
+			}
 		}
-	//clear_white_space();
-	if(new_char == COMMENT)
-	{
-		skip_line(); // skip the rest of char, return when reach LINE_END
-		return;
-	}
-	if(new_char!=LINE_END) // error on some other charector
-	{
-		// error out
-		//printf(" new_char = %i",new_char);
-		print_error("Syntax Error expected Comment or end of line.. ",source_line_number);
-		exit(-1);
-
 	}
+	return count;
 }
 
-void add_const_name()
+// code position of the first op with a missing label, LABEL_UNDEFINED if there is none.
+// With relocatable set branches and jumps are skipped, they have an ELF relocation that fits.
+uint32_t first_missing_label(Basm_Context *ctx,int relocatable)
 {
-
-	
-	const_buffer_position = 0;
-	while(TRUE)
+	uint32_t first = LABEL_UNDEFINED;
+	for(int type=TYPE_I;type<NUMBER_OF_TYPES;type++)
 	{
-		
-		// check if search reached last entry
-		if(const_buffer[const_buffer_position] == 0) 
+		if( relocatable && ( (type == TYPE_B) || (type == TYPE_J) ) )
 		{
-			// not enough memory left  in buffer
-			if( (const_buffer_position + tmp_token_buffer_length + 5)> LABEL_BUFFER_MAX )
-			{
-				//error out
-				print_error("Reached Max ammount of Consts ",source_line_number);
-				exit(-1);
-			}
-			// add label, start by adding const name size to the header byte
-			const_buffer[const_buffer_position] = tmp_token_buffer_length ;
-
-			
-			// store const_name
-			copy_buffer(tmp_token_buffer,&const_buffer[const_buffer_position+5],tmp_token_buffer_length);
-
-			// zero length , clear
-			tmp_token_buffer_length = 0	;		
-			return;
-   
+			continue;
 		}
-		else
+		Fixups *fixups = &ctx->fixups[type];
+		uint32_t *op_pos = (uint32_t*)fixups->op_pos.data;
+		uint32_t *label_pos = (uint32_t*)fixups->label_pos.data;
+		for(uint32_t i=0;i<fixups->count;i++)
 		{
-			// check if new const equal size of stored label
-			if(tmp_token_buffer_length==const_buffer[const_buffer_position])
+			uint32_t label_addr;
+			copy_buffer(&ctx->label_buffer.data[label_pos[i]],&label_addr,OP_CODE_SIZE);
+			if( (label_addr == LABEL_UNDEFINED) && (op_pos[i] < first) )
 			{
-				// compare if new label = old label
-				if(compare_buffer(&const_buffer[const_buffer_position+5],tmp_token_buffer,tmp_token_buffer_length))
-				{
-					//error out
-					print_error("Duplicate Const used ",source_line_number);
-					exit(-1);
-				}
+				first = op_pos[i];
 			}
-			// next_label
-			const_buffer_position = const_buffer_position + const_buffer[const_buffer_position] + 5;	
 		}
 	}
+	return first;
 }
 
-int32_t get_const()
+void file_finish(Basm_Context *ctx)
 {
-	//
-	int32_t number;
-	const_buffer_position = 0;
-	while(const_buffer[const_buffer_position]!=0)
+	if(ctx->relax)
 	{
-		// compare const name length
-		if(tmp_token_buffer_length==const_buffer[const_buffer_position])
-		{
-			// compare if const names are equal
-			if(compare_buffer(&const_buffer[const_buffer_position+5],tmp_token_buffer,tmp_token_buffer_length))
-			{
-				// TODO  copy out number
-				copy_buffer(&const_buffer[const_buffer_position+1],&number,OP_CODE_SIZE);
-				// return
-				return number;
-			}
-		}
-		// next_label
-		const_buffer_position = const_buffer_position + const_buffer[const_buffer_position] + 5;	
-		
+		relax_finish(ctx);
+		return;
+	}
+	uint32_t missing = LABEL_UNDEFINED;	// code position of the first op with a missing label
+	uint32_t out_of_range = ctx->streamed_out_of_range;
+	for(int type=TYPE_I;type<NUMBER_OF_TYPES;type++)
+	{
+		out_of_range += resolve_fixups(ctx,type,&missing);
+	}
+	if( (missing != LABEL_UNDEFINED) && ctx->keep_undefined )
+	{
+		missing = first_missing_label(ctx,TRUE);
+	}
+	if(missing != LABEL_UNDEFINED)
+	{
+		offset_warnings(ctx,ctx->streamed_out_of_range + count_offset_warnings(ctx,missing));
+		// error
+		assemble_error(ctx,"Error OP code used with Missing Label ",missing);
 	}
-	// error out
-	print_error("Const need to be defined before used ",source_line_number);
-	exit(-1);
+	offset_warnings(ctx,out_of_range);
 }
 
-void add_const_hex()
-{
-
-	int32_t number = convert_txt_to_hex();
-	int test = number;
-	//printf("added const %i \n ",test);	
-	// store hex number 
-	copy_buffer(&number,&const_buffer[const_buffer_position+1],OP_CODE_SIZE);
-	
-}
+// -------- Relaxation -----------------------------------
+// When relaxing every op that uses a label is saved as a fixup, then sized
+// here once all labels are known. An op starts in its smallest form and only
+// grows, so the passes stop at the first one that grows nothing. A pass is a
+// walk over the ops, how many ops come before each label is found once.
+//
+//	branch	c.beqz / c.bnez (2), B (4), opposite B + JAL (8), opposite B + AUIPC + JALR (12)
+//	jal		c.j (2), JAL (4), AUIPC + JALR (8)
+//
+// AUIPC + JALR need a register for the address. A JAL uses its rd, a branch
+// or a JAL with rd x0 only gets the form when a scratch register was named
+// with BASM_RELAX_SCRATCH, otherwise it is a range error on its line.
 
-int32_t convert_txt_to_hex()
+// relax ops before addr, ops are in code order
+uint32_t relax_ops_before(const Relax_Op *ops,uint32_t count,uint32_t addr)
 {
-	int32_t single_digit = 0;
-	int32_t hex_place = 1;
-	int32_t number = 0;
-	// iterate hex string from right to left, (tmp_token_buffer_length-1) for zero index
-	for(int i = (tmp_token_buffer_length-1);i>=0;i-- )
+	uint32_t low = 0;
+	uint32_t high = count;
+	while(low < high)
 	{
-
-		if( check_numbers(tmp_token_buffer[i]) )
-		{
-			single_digit = tmp_token_buffer[i] - 48;	// zero is 48 so minus 48.
-		}
-		if(  check_AF(tmp_token_buffer[i]) )
-		{
-			single_digit = tmp_token_buffer[i] - 55; // upper A is 65 so minus 55 leave us with digit 10
-		}
-		if(  check_af(tmp_token_buffer[i]) )
-		{
-			single_digit = tmp_token_buffer[i] - 87; // lower is 97 so minus 87 leave us with digit 10
-		}
-
-		if(tmp_token_buffer[i]==MINUS)
+		uint32_t middle = (low + high) / 2;
+		if(ops[middle].op_pos < addr)
 		{
-			number = number * (-1); // flip sign.
-			// function should exit after minus due to early check make sure minus is left most value	
+			low = middle + 1;
 		}
 		else
 		{
-			number = number + (single_digit*hex_place);
-			hex_place = hex_place * 16; // increase hex place by one hex power
+			high = middle;
 		}
-		
 	}
-	return number;
-}
-
-/*
-void next_label()		 // %0 
-{
-	
-	label_buffer_position = label_buffer_position + label_buffer[label_buffer_position] + 5;
-		
-}
-*/
-
-void get_label();			 // %0
-void save_op();
-
-
-//
-
-
-// ----------------- Range Checks -------------------
-
-int check_white_space(CHAR check)
-{
-	return ( (check == SPACE)||(check == TAB) );
+	return low;
 }
 
-int check_numbers(CHAR check) // numbers = 48 - 57
+// FALSE when offset is out of reach of the form the op has now
+int relax_fits(const Relax_Op *op,int32_t offset)
 {
-	if( (check > 47) && (check < 58) )
+	if(op->label_addr == LABEL_UNDEFINED)
 	{
 		return TRUE;
 	}
-	return FALSE;
-}
-
-int check_upper_case(CHAR check) // uppers = 65 - 90
-{
-	if( (check > 64) && (check < 91) )
+	if(op->type == TYPE_B)
 	{
-		return TRUE;
+		switch(op->size)
+		{
+			case C_OP_CODE_SIZE:	return C_FITS(offset,-256,254);
+			case OP_CODE_SIZE:		return C_FITS(offset,SIGNED_12_BIT_MIN,SIGNED_12_BIT_MAX - 1);
+			case OP_CODE_SIZE*2:	return C_FITS(offset - OP_CODE_SIZE,SIGNED_20_BIT_MIN,SIGNED_20_BIT_MAX - 1);
+		}
 	}
-	return FALSE;
-}
-
-int check_lower_case(CHAR check) // lowers = 97 - 122
-{
-	if( (check > 96) && (check < 123) )
+	else if(op->type == TYPE_J)
 	{
-		return TRUE;
+		switch(op->size)
+		{
+			case C_OP_CODE_SIZE:	return C_FITS(offset,-2048,2046);
+			case OP_CODE_SIZE:		return C_FITS(offset,SIGNED_20_BIT_MIN,SIGNED_20_BIT_MAX - 1);
+		}
 	}
-	return FALSE;
+	return TRUE;
 }
 
-int check_hex(CHAR check)
+// ops in code order, merged from the fixups of each type which are in order already
+uint32_t relax_collect(Basm_Context *ctx)
 {
-	if(check_numbers(check))  			// 0 - 9
+	uint32_t count = 0;
+	for(int type=TYPE_I;type<NUMBER_OF_TYPES;type++)
 	{
-		return TRUE;
+		count += ctx->fixups[type].count;
 	}
-	if( (check > 96) && (check < 103) )	// a - b
+	arena_reset(&ctx->relax_ops);
+	context_alloc(ctx,&ctx->relax_ops,count*sizeof(Relax_Op));
+	Relax_Op *ops = (Relax_Op*)ctx->relax_ops.data;
+	uint32_t next[NUMBER_OF_TYPES] = {0};
+	for(uint32_t i=0;i<count;i++)
 	{
-		return TRUE;
+		int type = TYPE_NONE;
+		uint32_t op_pos = 0;
+		for(int t=TYPE_I;t<NUMBER_OF_TYPES;t++)
+		{
+			Fixups *fixups = &ctx->fixups[t];
+			if( (next[t] < fixups->count) && ( (type == TYPE_NONE) || ( ((uint32_t*)fixups->op_pos.data)[next[t]] < op_pos ) ) )
+			{
+				type = t;
+				op_pos = ((uint32_t*)fixups->op_pos.data)[next[t]];
+			}
+		}
+		Fixups *fixups = &ctx->fixups[type];
+		uint32_t k = next[type]++;
+		Relax_Op *op = &ops[i];
+		zero_buffer(op,sizeof(Relax_Op));
+		op->op_pos = op_pos;
+		copy_buffer(&ctx->label_buffer.data[((uint32_t*)fixups->label_pos.data)[k]],&op->label_addr,OP_CODE_SIZE);
+		op->code = ((uint32_t*)fixups->code.data)[k];
+		op->fixup = k;
+		op->line = ((uint32_t*)fixups->line.data)[k];
+		op->type = type;
+		op->size = OP_CODE_SIZE;
+		if( ctx->compress && ( (type == TYPE_B) || (type == TYPE_J) ) && (op->label_addr != LABEL_UNDEFINED) && C_Compress(op->code) )
+		{
+			op->size = C_OP_CODE_SIZE;
+		}
 	}
-	if( (check > 64) && (check < 71) )	// A - B
+	for(uint32_t i=0;i<count;i++)
 	{
-		return TRUE;
+		ops[i].label_index = relax_ops_before(ops,count,ops[i].label_addr);
 	}
-	return FALSE;
+	return count;
 }
 
-int check_AF(CHAR check) // uppers = 65 - 70
+// bytes of the largest form a branch or jump may take
+uint32_t relax_max_size(Basm_Context *ctx,const Relax_Op *op)
 {
-	if( (check > 64) && (check < 71) )
+	if(op->type == TYPE_B)
 	{
-		return TRUE;
+		return ctx->relax_scratch ? OP_CODE_SIZE*3 : OP_CODE_SIZE*2;
 	}
-	return FALSE;
-}
-
-int check_af(CHAR check) // lowers = 97 - 102
-{
-	if( (check > 96) && (check < 103) )
+	if(op->type == TYPE_J)
 	{
-		return TRUE;
+		return ( ctx->relax_scratch || C_BITS(op->code,11,7) ) ? OP_CODE_SIZE*2 : OP_CODE_SIZE;
 	}
-	return FALSE;
+	return OP_CODE_SIZE;
 }
 
-// ---------------------------------------------------
-
-int compare_buffer(CHAR_PTR a,CHAR_PTR b,int size)
+// grows ops until every one reaches its label, shift[i] is then how far op i
+// moved, shift[count] how much the image grew
+void relax_layout(Basm_Context *ctx,Relax_Op *ops,uint32_t count,int32_t *shift)
 {
-	for(int i=0;i < size; i++)
+	int grew = TRUE;
+	while(grew)
 	{
-		if(a[i]==b[i])
+		grew = FALSE;
+		shift[0] = 0;
+		for(uint32_t i=0;i<count;i++)
 		{
-			continue;
+			shift[i+1] = shift[i] + ops[i].size - OP_CODE_SIZE;
 		}
-		else
+		for(uint32_t i=0;i<count;i++)
 		{
-			return FALSE;
+			int32_t offset = (ops[i].label_addr + shift[ops[i].label_index]) - (ops[i].op_pos + shift[i]);
+			if( !relax_fits(&ops[i],offset) )
+			{
+				if(ops[i].size >= relax_max_size(ctx,&ops[i]))
+				{
+					assemble_error(ctx,"Error Offset out of scope without a relax scratch register ",ops[i].line);
+				}
+				ops[i].size = (ops[i].size == C_OP_CODE_SIZE) ? OP_CODE_SIZE : ops[i].size + OP_CODE_SIZE;
+				grew = TRUE;
+			}
 		}
 	}
-	return TRUE;	
-}		 
-void copy_buffer(void *src,void *dst,int size)
+}
+
+// AUIPC + JALR to offset from the AUIPC, the address goes through tmp
+void relax_far_jump(uint32_t *code,int32_t offset,uint8_t rd,uint8_t tmp)
 {
-	for(int i = 0; i<size ;i++)
-	{
-		((uint8_t*)dst)[i] = ((uint8_t*)src)[i];
-	}
+	int32_t high = (offset + 0x800) >> 12;	// JALR adds the low 12 bits sign extended
+	code[0] = U_Type(high, tmp, OPCODE_AUIPC);
+	code[1] = I_Type(offset - high*4096, tmp, 0, rd, OPCODE_JALR);
 }
 
-void zero_buffer(void *buffer,int size)
+// writes op at pos in the form it was sized to, returns 1 if its offset does not fit
+uint32_t relax_encode(Basm_Context *ctx,const Relax_Op *op,uint32_t pos,uint32_t target,uint8_t *dst)
 {
-	for(int i =0;i<size;i++)
+	int32_t offset = (op->label_addr == LABEL_UNDEFINED) ? 0 : (int32_t)(target - pos);
+	uint32_t code[3] = { op->code, 0, 0 };
+	uint32_t out_of_range = 0;
+	switch(op->type)
 	{
-		((uint8_t*)buffer)[i] = 0;
+		case TYPE_I:
+			out_of_range = (offset > SIGNED_12_BIT_MAX) | (offset < SIGNED_12_BIT_MIN);
+			code[0] |= I_Type(offset,0,0,0,0);
+			break;
+		case TYPE_S:
+			out_of_range = (offset > SIGNED_12_BIT_MAX) | (offset < SIGNED_12_BIT_MIN);
+			code[0] |= S_Type(offset,0,0,0,0);
+			break;
+		case TYPE_U:
+			out_of_range = (offset > SIGNED_20_BIT_MAX) | (offset < SIGNED_20_BIT_MIN);
+			code[0] |= U_Type(offset,0,0);
+			break;
+		case TYPE_B:
+			if(op->size <= OP_CODE_SIZE)
+			{
+				code[0] |= B_Type(offset,0,0,0,0);
+				break;
+			}
+			// the opposite branch steps over the jump
+			code[0] = (op->code ^ (1 << 12)) | B_Type(op->size,0,0,0,0);
+			if(op->size == OP_CODE_SIZE*2)
+			{
+				code[1] = J_Type(offset - OP_CODE_SIZE, 0, OPCODE_JAL);
+			}
+			else
+			{
+				relax_far_jump(&code[1],offset - OP_CODE_SIZE,0,ctx->relax_scratch);
+			}
+			break;
+		case TYPE_J:
+			if(op->size <= OP_CODE_SIZE)
+			{
+				code[0] |= J_Type(offset,0,0);
+				break;
+			}
+			uint8_t rd = C_BITS(op->code,11,7);
+			relax_far_jump(code,offset,rd,rd ? rd : ctx->relax_scratch);
+			break;
 	}
-	return;
+	if(op->size == C_OP_CODE_SIZE)
+	{
+		CODE16 compressed = C_Compress(code[0]);
+		copy_buffer(&compressed,dst,C_OP_CODE_SIZE);
+		return 0;
+	}
+	copy_buffer(code,dst,op->size);
+	return out_of_range;
 }
 
-
-// -------- main() --------------------------------------
-
-int main( int argc, char *argv[] ) 
+// the image again with every op in its form, labels and fixups moved to match
+void relax_finish(Basm_Context *ctx)
 {
-
-	if(argc != 3 )
+	uint32_t missing = first_missing_label(ctx,ctx->keep_undefined);
+	if(missing != LABEL_UNDEFINED)
 	{
-		// print help msg
-		print_error("\n basm_riscv [source_file_name] [binary_file_name]",-1);
-		exit(-1);
+		assemble_error(ctx,"Error OP code used with Missing Label ",missing);
 	}
-
-	char *input_file = argv[1];
-	char *output_file = argv[2];
-	
-	
-	if( !init_files(input_file,output_file) )
+	uint32_t count = relax_collect(ctx);
+	Relax_Op *ops = (Relax_Op*)ctx->relax_ops.data;
+	arena_reset(&ctx->fixup_offsets);
+	context_alloc(ctx,&ctx->fixup_offsets,(count + 1)*sizeof(int32_t));
+	int32_t *shift = (int32_t*)ctx->fixup_offsets.data;
+	relax_layout(ctx,ops,count,shift);
+
+	Arena image = {0};
+	uint32_t size = ctx->output_code.size + shift[count];
+	if( !arena_reserve(&image,size) )
 	{
-		// May move this error to init_files to give info on which file errored. 
-		print_error("\n Error opening file",-1);
-		exit(-1);	
+		assemble_error(ctx,"Error Out of memory ",-1);
 	}
-	init_instructions(op_name,op_const);
-	start_parser();
-	reopen_for_update(output_file);
-	file_finish();
-	close_files();
-	print_error("\n Assembled with no Errors",-1);
-	return 0;	
-		
-}
+	image.size = size;
+	const uint8_t *old = ctx->output_code.data;
+	uint32_t from = 0;
+	uint32_t out_of_range = 0;
+	for(uint32_t i=0;i<count;i++)
+	{
+		const Relax_Op *op = &ops[i];
+		memcpy(&image.data[from + shift[i]],&old[from],op->op_pos - from);
+		uint32_t pos = op->op_pos + shift[i];
+		out_of_range += relax_encode(ctx,op,pos,op->label_addr + shift[op->label_index],&image.data[pos]);
+		((uint32_t*)ctx->fixups[op->type].op_pos.data)[op->fixup] = pos;	// for ELF relocations
+		from = op->op_pos + OP_CODE_SIZE;
+	}
+	memcpy(&image.data[from + shift[count]],&old[from],ctx->output_code.size - from);
+	arena_free(&ctx->output_code);
+	ctx->output_code = image;
+	ctx->output_code_position = size;
+	ctx->text_end += shift[relax_ops_before(ops,count,ctx->text_end)];
 
-void start_parser()
-{
-	zero_buffer(label_buffer,LABEL_BUFFER_MAX);
-	while(!reached_end_of_file)
+	for(uint32_t pos = 0;pos < ctx->label_buffer.size;pos += ctx->label_buffer.data[pos] + LABEL_HEADER)
 	{
-		parser_start_new_line();	
+		uint32_t label_addr;
+		copy_buffer(&ctx->label_buffer.data[pos+1],&label_addr,OP_CODE_SIZE);
+		if(label_addr != LABEL_UNDEFINED)
+		{
+			label_addr += shift[relax_ops_before(ops,count,label_addr)];
+			copy_buffer(&label_addr,&ctx->label_buffer.data[pos+1],OP_CODE_SIZE);
+		}
 	}
-	// load label values into opcodes
+	offset_warnings(ctx,out_of_range);
 }
 
-/*
-void parse_Const()			 // %0
+
+void binary_write_data(Basm_Context *ctx,uint32_t data)
 {
-	
+	//printf("Store value %08x  at location %08X \n ",data,ctx->output_code_position);
+	uint32_t offset = context_alloc(ctx,&ctx->output_code,OP_CODE_SIZE);
+	copy_buffer(&data,&ctx->output_code.data[offset],OP_CODE_SIZE);
+	ctx->output_code_position += 4; // 4 is opcode size
 }
-*/
-int32_t get_label_offset_check(uint32_t num)
+
+// an encoded op, in its 16 bit form when compressing and it has one
+void binary_write_op(Basm_Context *ctx,uint32_t code)
 {
-	uint32_t label_addr;
-	copy_buffer(&label_buffer[op_saves[num].label_pos], &label_addr,OP_CODE_SIZE);
-	if( label_addr == 0xffffffff)
+	CODE16 compressed;
+	STATS_COUNT(ctx,instructions,1);
+	if( ctx->compress && ( (compressed = C_Compress(code)) != 0 ) )
 	{
-		// error
-		print_error("Error OP code used with Missing Label ",op_saves[num].op_pos);
-		exit(-1);
+		uint32_t offset = binary_write_bytes(ctx,C_OP_CODE_SIZE);
+		copy_buffer(&compressed,&ctx->output_code.data[offset],C_OP_CODE_SIZE);
+		return;
 	}
-	return  label_addr - op_saves[num].op_pos;	
+	binary_write_data(ctx,code);
 }
 
-
-void file_finish()
+// makes room for bytes at the end of the image, returns their offset in output_code
+uint32_t binary_write_bytes(Basm_Context *ctx,uint32_t bytes)
 {
+	uint32_t offset = context_alloc(ctx,&ctx->output_code,bytes);
+	ctx->output_code_position += bytes;
+	return offset;
+}
 
-	int32_t imm_cal;
-	for(uint32_t i=0;i<op_saves_pos;i++)
+// zeros up to the next OP_CODE_SIZE boundary
+void binary_write_padding(Basm_Context *ctx)
+{
+	uint32_t padding = (OP_CODE_SIZE - (ctx->output_code_position % OP_CODE_SIZE)) % OP_CODE_SIZE;
+	if(padding)
 	{
-		// Get the type of op to encode.
-		switch(op_const[op_saves[i].op_id].op_type )
-		{
-			case TYPE_R:
-				// error
-				exit(-1);
-			
-			case TYPE_I:
-				// gets and set offset for label
-				imm_cal = get_label_offset_check(i);
-				// set position in file
-				set_code_pos(op_saves[i].op_pos);
-				// write
-				binary_write_data( I_Type(	check_12bit(imm_cal) ,
-											op_saves[i].rs1	,
-											op_const[op_saves[i].op_id].p_known[1] ,
-											op_saves[i].rd	,
-											op_const[op_saves[i].op_id].p_known[0]) );
-				break;
-				
-			case TYPE_B:
-				// gets and set offset for label
-				imm_cal = get_label_offset_check(i);
-				// set position in file
-				set_code_pos(op_saves[i].op_pos);
-				// write
-				binary_write_data( B_Type(	check_12bit(imm_cal) ,
-											op_saves[i].rs2	,
-											op_saves[i].rs1	,
-											op_const[op_saves[i].op_id].p_known[1] ,
-											op_const[op_saves[i].op_id].p_known[0]) );
-				break;
-				
-			case TYPE_S:
-				// gets and set offset for label
-				imm_cal = get_label_offset_check(i);
-				// set position in file
-				set_code_pos(op_saves[i].op_pos);
-				// write
-				binary_write_data( S_Type(	check_12bit(imm_cal) ,
-											op_saves[i].rs1	,
-											op_saves[i].rs2	,
-											op_const[op_saves[i].op_id].p_known[1] ,
-											op_const[op_saves[i].op_id].p_known[0]) );
-				break;			
-			case TYPE_J:
-				// gets and set offset for label
-				imm_cal = get_label_offset_check(i);
-				// set position in file
-				set_code_pos(op_saves[i].op_pos);
-				// write
-				binary_write_data( J_Type(	check_20bit(imm_cal) ,
-											op_saves[i].rd	,
-											op_const[op_saves[i].op_id].p_known[0]) );
-				break;
-			case TYPE_U:
-				// gets and set offset for label
-				imm_cal = get_label_offset_check(i);
-				// set position in file
-				set_code_pos(op_saves[i].op_pos);
-				// write
-				binary_write_data( U_Type(	check_20bit(imm_cal) ,
-											op_saves[i].rd	,
-											op_const[op_saves[i].op_id].p_known[0]) );
-				break;
-		}
+		uint32_t offset = binary_write_bytes(ctx,padding);
+		zero_buffer(&ctx->output_code.data[offset],padding);
 	}
-	
 }
 
-
-void binary_write_data(uint32_t data)// TODO write to file instead of printf
+// fill in an op saved by save_op()
+void patch_code(Basm_Context *ctx,uint32_t pos,uint32_t data)
 {
-	//printf("Store value %08x  at location %08X \n ",data,output_code_position);
-	put_code(data);
-	output_code_position += 4; // 4 is opcode size
+	copy_buffer(&data,&ctx->output_code.data[pos - ctx->output_flushed],OP_CODE_SIZE);
 }
 
 
-void parse_type_r(uint8_t id) // rd, rs1 ,rs2
+void parse_type_r(Basm_Context *ctx,uint8_t id) // rd, rs1 ,rs2
 {
 	uint8_t rd;
 	uint8_t rs1;
 	uint8_t rs2;
 	
-	rd = get_reg();
-	if(new_char != COMMA)
+	rd = get_reg(ctx);
+	if(ctx->new_char != COMMA)
 	{
 		// error out
-		print_error("Error Expected Comma  here ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error Expected Comma  here ",ctx->source_line_number);
 	}
 	//printf("first reg");
-	clear_white_space();
-	rs1 = get_reg();
-	if(new_char != COMMA)
+	clear_white_space(ctx);
+	rs1 = get_reg(ctx);
+	if(ctx->new_char != COMMA)
 		{
 			// error out
-			print_error("Error Expected Comma  here ",source_line_number);
-			exit(-1);
+			assemble_error(ctx,"Error Expected Comma  here ",ctx->source_line_number);
 
 		}
-	clear_white_space();
-	rs2 = get_reg();
+	clear_white_space(ctx);
+	rs2 = get_reg(ctx);
 		
 	// finish line
-	//next_char();
-	find_end_of_line();
+	//next_char(ctx);
+	find_end_of_line(ctx);
 
 	// TODO replace with write function
 	//printf(" id=%i, rd=%i, rs1=%i, rs2=%i ",id,rd,rs1,rs2);
-	binary_write_data( R_Type(op_const[id].p_known[2], rs2 ,rs1,op_const[id].p_known[1],rd, op_const[id].p_known[0]) );	
+	STATS_START(ctx);
+	binary_write_op(ctx, R_Type(op_info[id].fun7, rs2 ,rs1,op_info[id].fun3,rd, op_info[id].op) );
+	STATS_END(ctx,encode_time);
 	
 }
 
 
 
 // rd, rs1, imm12
-void parse_type_i(uint8_t id)
+void parse_type_i(Basm_Context *ctx,uint8_t id)
 {
 	uint8_t		rd;
 	uint8_t 	rs1;
 	int32_t 	imm12;
 
-	rd = get_reg();
-	if(new_char != COMMA)
+	rd = get_reg(ctx);
+	if(ctx->new_char != COMMA)
 	{
 		// error out
-		print_error("Error Expected Comma  here ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error Expected Comma  here ",ctx->source_line_number);
 	}
 	//printf("first reg");
-	clear_white_space();
-	rs1 = get_reg();
-	if(new_char != COMMA)
+	clear_white_space(ctx);
+	rs1 = get_reg(ctx);
+	if(ctx->new_char != COMMA)
 		{
 			// error out
-			print_error("Error Expected Comma  here ",source_line_number);
-			exit(-1);
+			assemble_error(ctx,"Error Expected Comma  here ",ctx->source_line_number);
 
 		}	
 
-	clear_white_space();
-	if( (check_hex(new_char) ) || (new_char == MINUS) )
+	clear_white_space(ctx);
+	if( (check_hex(ctx->new_char) ) || (ctx->new_char == MINUS) )
 	{
-		load_hex_to_tmp();	
-		imm12 = convert_txt_to_hex();
+		load_hex_to_tmp(ctx);	
+		imm12 = convert_txt_to_hex(ctx);
 	}
-	else if(new_char == AT_SIGN)
+	else if(ctx->new_char == AT_SIGN)
 	{
-		clear_white_space();
-		load_name_to_tmp();
-		imm12 = get_const();
+		clear_white_space(ctx);
+		load_name_token(ctx);
+		imm12 = get_const(ctx);
 			
-		//next_char();
+		//next_char(ctx);
 		
 	}
-	else if(new_char == GREATER_THAN)
+	else if(ctx->new_char == GREATER_THAN)
 	{
-		clear_white_space();
-		load_name_to_tmp();
+		clear_white_space(ctx);
+		load_name_token(ctx);
 
-		if(!have_label(&imm12) )
+		if(!have_label(ctx,&imm12) )
 		{
 			// store op
-			op_saves[op_saves_pos].op_id 		= id;
-			op_saves[op_saves_pos].rd 			= rd;
-			op_saves[op_saves_pos].rs1 			= rs1;
-			op_saves[op_saves_pos].label_pos 	= imm12;
-			op_saves[op_saves_pos].op_pos		= output_code_position;
-			op_saves_pos++;
-			binary_write_data(0xffffffff);
+			save_op(ctx,id,rd,rs1,0,imm12);
+			binary_write_data(ctx,0xffffffff);
 				
-			find_end_of_line();
+			find_end_of_line(ctx);
 			return;	
 		}
-		find_end_of_line();	
-		binary_write_data( I_Type(check_12bit(imm12), rs1, op_const[id].p_known[1] ,rd, op_const[id].p_known[0] ) );
+		find_end_of_line(ctx);	
+		STATS_START(ctx);
+		binary_write_op(ctx, I_Type(check_12bit(ctx,imm12), rs1, op_info[id].fun3 ,rd, op_info[id].op ) );
+		STATS_END(ctx,encode_time);
 		return;		
 	}
 	else
 	{
 		// error out
-		print_error("Error Bad Sytax ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error Bad Sytax ",ctx->source_line_number);
 	}
-	find_end_of_line();	
-	binary_write_data( I_Type(imm12, rs1, op_const[id].p_known[1] ,rd, op_const[id].p_known[0] ) );
+	find_end_of_line(ctx);	
+	STATS_START(ctx);
+	binary_write_op(ctx, I_Type(imm12, rs1, op_info[id].fun3 ,rd, op_info[id].op ) );
+	STATS_END(ctx,encode_time);
 	
 }
 // rs1, rs2, offset12
-void parse_type_b(uint8_t id)
+void parse_type_b(Basm_Context *ctx,uint8_t id)
 {
 	uint8_t		rs1;
 	uint8_t 	rs2;
 	int32_t 	imm12;
 
-	rs1 = get_reg();
-	if(new_char != COMMA)
+	rs1 = get_reg(ctx);
+	if(ctx->new_char != COMMA)
 	{
 		// error out
-		print_error("Error Expected Comma  here ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error Expected Comma  here ",ctx->source_line_number);
 	}
 	//printf("first reg");
-	clear_white_space();
-	rs2 = get_reg();
-	if(new_char != COMMA)
+	clear_white_space(ctx);
+	rs2 = get_reg(ctx);
+	if(ctx->new_char != COMMA)
 		{
 			// error out
-			print_error("Error Expected Comma  here ",source_line_number);
-			exit(-1);
+			assemble_error(ctx,"Error Expected Comma  here ",ctx->source_line_number);
 
 		}	
 
-	clear_white_space();
-	if( (check_hex(new_char) ) || (new_char == MINUS) )
+	clear_white_space(ctx);
+	if( (check_hex(ctx->new_char) ) || (ctx->new_char == MINUS) )
 	{
-		load_hex_to_tmp();	
-		imm12 = convert_txt_to_hex();
+		load_hex_to_tmp(ctx);	
+		imm12 = convert_txt_to_hex(ctx);
 	}
-	else if(new_char == AT_SIGN)
+	else if(ctx->new_char == AT_SIGN)
 	{
-		clear_white_space();
-		load_name_to_tmp();
-		imm12 = get_const();
+		clear_white_space(ctx);
+		load_name_token(ctx);
+		imm12 = get_const(ctx);
 			
-		//next_char();
+		//next_char(ctx);
 		
 	}
-	else if(new_char == GREATER_THAN)
+	else if(ctx->new_char == GREATER_THAN)
 	{
-		clear_white_space();
-		load_name_to_tmp();
+		clear_white_space(ctx);
+		load_name_token(ctx);
 
-		if(!have_label(&imm12) )
+		if(!have_label(ctx,&imm12) )
 		{
 			// store op
-			op_saves[op_saves_pos].op_id 		= id;
-			op_saves[op_saves_pos].rs1 			= rs1;
-			op_saves[op_saves_pos].rs2 			= rs2;
-			op_saves[op_saves_pos].label_pos 	= imm12;
-			op_saves[op_saves_pos].op_pos		= output_code_position;
-			op_saves_pos++;
-			binary_write_data(0xffffffff);
+			save_op(ctx,id,0,rs1,rs2,imm12);
+			binary_write_data(ctx,0xffffffff);
 				
-			find_end_of_line();
+			find_end_of_line(ctx);
 			return;	
 		}
-		find_end_of_line();	
-		binary_write_data( B_Type(check_12bit(imm12), rs2, rs1, op_const[id].p_known[1] , op_const[id].p_known[0] ) );
+		find_end_of_line(ctx);	
+		STATS_START(ctx);
+		binary_write_op(ctx, B_Type(check_12bit(ctx,imm12), rs2, rs1, op_info[id].fun3 , op_info[id].op ) );
+		STATS_END(ctx,encode_time);
 		return;
 	}
 	else
 	{
 		// error out
-		print_error("Error Bad Sytax ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error Bad Sytax ",ctx->source_line_number);
 	}
 
-	find_end_of_line();	
-	binary_write_data( B_Type(imm12, rs2, rs1, op_const[id].p_known[1] , op_const[id].p_known[0] ) );
+	find_end_of_line(ctx);	
+	STATS_START(ctx);
+	binary_write_op(ctx, B_Type(imm12, rs2, rs1, op_info[id].fun3 , op_info[id].op ) );
+	STATS_END(ctx,encode_time);
 }
 // rs2, rs1, offset12
-void parse_type_s(uint8_t id)
+void parse_type_s(Basm_Context *ctx,uint8_t id)
 {
 	uint8_t		rs1;
 	uint8_t 	rs2;
 	int32_t 	imm12;
 
-	rs1 = get_reg();
-	if(new_char != COMMA)
+	rs1 = get_reg(ctx);
+	if(ctx->new_char != COMMA)
 	{
 		// error out
-		print_error("Error Expected Comma  here ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error Expected Comma  here ",ctx->source_line_number);
 	}
 	//printf("first reg");
-	clear_white_space();
-	rs2 = get_reg();
-	if(new_char != COMMA)
+	clear_white_space(ctx);
+	rs2 = get_reg(ctx);
+	if(ctx->new_char != COMMA)
 		{
 			// error out
-			print_error("Error Expected Comma  here ",source_line_number);
-			exit(-1);
+			assemble_error(ctx,"Error Expected Comma  here ",ctx->source_line_number);
 
 		}	
 
-	clear_white_space();
-	if( (check_hex(new_char) ) || (new_char == MINUS) )
+	clear_white_space(ctx);
+	if( (check_hex(ctx->new_char) ) || (ctx->new_char == MINUS) )
 	{
-		load_hex_to_tmp();	
-		imm12 = convert_txt_to_hex();
+		load_hex_to_tmp(ctx);	
+		imm12 = convert_txt_to_hex(ctx);
 	}
-	else if(new_char == AT_SIGN)
+	else if(ctx->new_char == AT_SIGN)
 	{
-		clear_white_space();
-		load_name_to_tmp();
-		imm12 = get_const();
+		clear_white_space(ctx);
+		load_name_token(ctx);
+		imm12 = get_const(ctx);
 			
-		//next_char();
+		//next_char(ctx);
 		
 	}
-	else if(new_char == GREATER_THAN)
+	else if(ctx->new_char == GREATER_THAN)
 	{
-		clear_white_space();
-		load_name_to_tmp();
+		clear_white_space(ctx);
+		load_name_token(ctx);
 
-		if(!have_label(&imm12) )
+		if(!have_label(ctx,&imm12) )
 		{
 			// store op
-			op_saves[op_saves_pos].op_id 		= id;
-			op_saves[op_saves_pos].rs1 			= rs1;
-			op_saves[op_saves_pos].rs2 			= rs2;
-			op_saves[op_saves_pos].label_pos 	= imm12;
-			op_saves[op_saves_pos].op_pos		= output_code_position;
-			op_saves_pos++;
-			binary_write_data(0xffffffff);
+			save_op(ctx,id,0,rs1,rs2,imm12);
+			binary_write_data(ctx,0xffffffff);
 				
-			find_end_of_line();
+			find_end_of_line(ctx);
 			return;	
 		}
-		find_end_of_line();
+		find_end_of_line(ctx);
 			// rs1 and rs2 are flipped for b_types	
-		binary_write_data( S_Type(check_12bit(imm12), rs1, rs2, op_const[id].p_known[1] , op_const[id].p_known[0] ) );
+		STATS_START(ctx);
+		binary_write_op(ctx, S_Type(check_12bit(ctx,imm12), rs1, rs2, op_info[id].fun3 , op_info[id].op ) );
+		STATS_END(ctx,encode_time);
 		return;
 	}
 	else
 	{
 		// error out
-		print_error("Error Bad Sytax ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error Bad Sytax ",ctx->source_line_number);
 	}
 
-	find_end_of_line();
+	find_end_of_line(ctx);
 	// rs1 and rs2 are flipped for b_types	
-	binary_write_data( S_Type(imm12, rs1, rs2, op_const[id].p_known[1] , op_const[id].p_known[0] ) );	
+	STATS_START(ctx);
+	binary_write_op(ctx, S_Type(imm12, rs1, rs2, op_info[id].fun3 , op_info[id].op ) );
+	STATS_END(ctx,encode_time);
 }
 // rd, offset20
-void parse_type_j(uint8_t id)
+void parse_type_j(Basm_Context *ctx,uint8_t id)
 {
 	uint8_t		rd;
 	int32_t 	imm20;
 
-	rd = get_reg();
-	if(new_char != COMMA)
+	rd = get_reg(ctx);
+	if(ctx->new_char != COMMA)
 	{
 		// error out
-		print_error("Error Expected Comma  here ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error Expected Comma  here ",ctx->source_line_number);
 	}
 	
-	clear_white_space();
-	if( (check_hex(new_char) ) || (new_char == MINUS) )
+	clear_white_space(ctx);
+	if( (check_hex(ctx->new_char) ) || (ctx->new_char == MINUS) )
 	{
-		load_hex_to_tmp();	
-		imm20 = convert_txt_to_hex();
+		load_hex_to_tmp(ctx);	
+		imm20 = convert_txt_to_hex(ctx);
 	}
-	else if(new_char == AT_SIGN)
+	else if(ctx->new_char == AT_SIGN)
 	{
-		clear_white_space();
-		load_name_to_tmp();
-		imm20 = get_const();
+		clear_white_space(ctx);
+		load_name_token(ctx);
+		imm20 = get_const(ctx);
 			
-		//next_char();
+		//next_char(ctx);
 		
 	}
-	else if(new_char == GREATER_THAN)
+	else if(ctx->new_char == GREATER_THAN)
 	{
-		clear_white_space();
-		load_name_to_tmp();
+		clear_white_space(ctx);
+		load_name_token(ctx);
 
-		if(!have_label(&imm20) )
+		if(!have_label(ctx,&imm20) )
 		{
 			// store op
-			op_saves[op_saves_pos].op_id 		= id;
-			op_saves[op_saves_pos].rd			= rd;
-			op_saves[op_saves_pos].label_pos 	= imm20;
-			op_saves[op_saves_pos].op_pos		= output_code_position;
-			op_saves_pos++;
-			binary_write_data(0xffffffff);		
-			find_end_of_line();
+			save_op(ctx,id,rd,0,0,imm20);
+			binary_write_data(ctx,0xffffffff);		
+			find_end_of_line(ctx);
 			return;	
 		}
-		find_end_of_line();	
-		binary_write_data( J_Type(check_20bit(imm20), rd , op_const[id].p_known[0] ) );	
+		find_end_of_line(ctx);	
+		STATS_START(ctx);
+		binary_write_op(ctx, J_Type(check_20bit(ctx,imm20), rd , op_info[id].op ) );
+		STATS_END(ctx,encode_time);
 		return;
 		
 	}
 	else
 	{
 		// error out
-		print_error("Error Bad Sytax ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error Bad Sytax ",ctx->source_line_number);
 	}
 
-	find_end_of_line();	
-	binary_write_data( J_Type(imm20, rd , op_const[id].p_known[0] ) );	
+	find_end_of_line(ctx);	
+	STATS_START(ctx);
+	binary_write_op(ctx, J_Type(imm20, rd , op_info[id].op ) );
+	STATS_END(ctx,encode_time);
 }
 // rd, imm20
-void parse_type_u(uint8_t id)
+void parse_type_u(Basm_Context *ctx,uint8_t id)
 {
 	uint8_t		rd;
 	int32_t 	imm20;
 
-	rd = get_reg();
-	if(new_char != COMMA)
+	rd = get_reg(ctx);
+	if(ctx->new_char != COMMA)
 	{
 		// error out
-		print_error("Error Expected Comma  here ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error Expected Comma  here ",ctx->source_line_number);
 	}
 	
-	clear_white_space();
-	if( (check_hex(new_char) ) || (new_char == MINUS) )
+	clear_white_space(ctx);
+	if( (check_hex(ctx->new_char) ) || (ctx->new_char == MINUS) )
 	{
-		load_hex_to_tmp();	
-		imm20 = convert_txt_to_hex();
+		load_hex_to_tmp(ctx);	
+		imm20 = convert_txt_to_hex(ctx);
 	}
-	else if(new_char == AT_SIGN)
+	else if(ctx->new_char == AT_SIGN)
 	{
-		clear_white_space();
-		load_name_to_tmp();
-		imm20 = get_const();
+		clear_white_space(ctx);
+		load_name_token(ctx);
+		imm20 = get_const(ctx);
 			
-		//next_char();
+		//next_char(ctx);
 		
 	}
-	else if(new_char == GREATER_THAN)
+	else if(ctx->new_char == GREATER_THAN)
 	{
-		clear_white_space();
-		load_name_to_tmp();
+		clear_white_space(ctx);
+		load_name_token(ctx);
 
-		if(!have_label(&imm20) )
+		if(!have_label(ctx,&imm20) )
 		{
 			// store op
-			op_saves[op_saves_pos].op_id 		= id;
-			op_saves[op_saves_pos].rd			= rd;
-			op_saves[op_saves_pos].label_pos 	= imm20;
-			op_saves[op_saves_pos].op_pos		= output_code_position;
-			op_saves_pos++;
-			binary_write_data(0xffffffff);
+			save_op(ctx,id,rd,0,0,imm20);
+			binary_write_data(ctx,0xffffffff);
 				
-			find_end_of_line();
+			find_end_of_line(ctx);
 			return;	
 		}
-			find_end_of_line();	
-			binary_write_data( U_Type(check_20bit(imm20), rd , op_const[id].p_known[0] ) );	
+			find_end_of_line(ctx);	
+			STATS_START(ctx);
+			binary_write_op(ctx, U_Type(check_20bit(ctx,imm20), rd , op_info[id].op ) );
+			STATS_END(ctx,encode_time);
 			return;
 
 		
@@ -1519,50 +4154,48 @@ void parse_type_u(uint8_t id)
 	else
 	{
 		// error out
-		print_error("Error Bad Sytax ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error Bad Sytax ",ctx->source_line_number);
 	}
 
-	find_end_of_line();	
-	binary_write_data( U_Type(imm20, rd , op_const[id].p_known[0] ) );	
+	find_end_of_line(ctx);	
+	STATS_START(ctx);
+	binary_write_op(ctx, U_Type(imm20, rd , op_info[id].op ) );
+	STATS_END(ctx,encode_time);
 }
 
 
-uint8_t get_reg()
+uint8_t get_reg(Basm_Context *ctx)
 {
-	//printf(" %i ",new_char);
-	if( !(check_upper_case(new_char)||check_lower_case(new_char)) )
+	//printf(" %i ",ctx->new_char);
+	if( !CHAR_IS(ctx->new_char,CHAR_LETTER) )
 	{
 		// error out
-		print_error("Error with Syntax no Letter to Start Reg ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error with Syntax no Letter to Start Reg ",ctx->source_line_number);
 	}
 
-	clear_white_space();
-	load_name_to_tmp();
+	clear_white_space(ctx);
+	load_name_token(ctx);
 
-	//printf(" %i %i ",tmp_token_buffer[0],tmp_token_buffer[1]);
+	//printf(" %i %i ",ctx->token[0],ctx->token[1]);
 	
-	if( (tmp_token_buffer_length == 1) && ( check_numbers(tmp_token_buffer[0]) ) )
+	if( (ctx->token_length == 1) && ( check_numbers(ctx->token[0]) ) )
 	{
-		return (tmp_token_buffer[0] - 48);		
+		return (ctx->token[0] - 48);		
 	}
-	else if( (tmp_token_buffer_length == 2) && ( check_numbers(tmp_token_buffer[0]) ) && ( check_numbers(tmp_token_buffer[1]) ) )
+	else if( (ctx->token_length == 2) && ( check_numbers(ctx->token[0]) ) && ( check_numbers(ctx->token[1]) ) )
 	{	
-		uint8_t tmp = ( (tmp_token_buffer[0] - 48)*10) + (tmp_token_buffer[1] - 48);
+		uint8_t tmp = ( (ctx->token[0] - 48)*10) + (ctx->token[1] - 48);
 		if(tmp>31)
 		{
 			//error out
-			print_error("Error Reg to Big ",source_line_number);
-			exit(-1);
+			assemble_error(ctx,"Error Reg to Big ",ctx->source_line_number);
 		}
 		return tmp;
 	}
 	else
 	{
 		// error out
-		print_error("Error with Reg Syntax ",source_line_number);
-		exit(-1);
+		assemble_error(ctx,"Error with Reg Syntax ",ctx->source_line_number);
 	}
 	
 }
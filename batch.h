@@ -0,0 +1,216 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<pthread.h>
+
+#include"basm.h"
+
+// Multi input mode, basm_rv -j N a.s b.s ...
+// Every source is assembled on its own context by a pool of N workers,
+// a.s is written to a.bin. A source's messages are kept until it is done and
+// then printed together, each line starting with the source's name, so lines
+// from different sources do not mix.
+
+#define BATCH_MAX_THREADS		256
+#define BATCH_OUTPUT_EXT	".bin"
+
+typedef struct Batch_Job
+{
+	char*			input_file;
+	char*			output_file;
+	int				failed;
+	basm_output		out;	// only error and error_line are kept
+}Batch_Job;
+
+typedef struct Batch
+{
+	Batch_Job*		jobs;
+	int				job_count;
+	int				next_job;
+	pthread_mutex_t	lock;
+}Batch;
+
+// a.s -> a.bin, anything without an extension just gets .bin added, and so
+// does a.bin so the source is never written over
+char* batch_output_name(char *input_file)
+{
+	size_t length = strlen(input_file);
+	char *dot = strrchr(input_file,'.');
+	char *slash = strrchr(input_file,'/');
+	if( (dot != NULL) && (dot != input_file) && ( (slash == NULL) || (dot > slash+1) ) && (strcmp(dot,BATCH_OUTPUT_EXT) != 0) )
+	{
+		length = dot - input_file;
+	}
+	char *name = malloc(length + sizeof(BATCH_OUTPUT_EXT));
+	if(name == NULL)
+	{
+		return NULL;
+	}
+	memcpy(name,input_file,length);
+	memcpy(&name[length],BATCH_OUTPUT_EXT,sizeof(BATCH_OUTPUT_EXT));
+	return name;
+}
+
+void batch_fail(Batch_Job *job,char *error)
+{
+	snprintf(job->out.error,BASM_ERROR_SIZE,"%s",error);
+	job->out.error_line = 0;
+	job->failed = 1;
+}
+
+void batch_run_job(Batch_Job *job)
+{
+	Source_File source;
+	if( !load_source(job->input_file,&source) )
+	{
+		batch_fail(job,"\n Error opening file");
+		return;
+	}
+	char *data_dir = source_dir(job->input_file);
+	int failed = basm_assemble_dir((const char*)source.data,source.size,BASM_KEEP_MESSAGES,data_dir,&job->out,NULL);
+	free(data_dir);
+	release_source(&source);
+	if(failed)
+	{
+		job->failed = 1;
+		return;
+	}
+
+	FILE *output_file_ptr = NULL;
+	if( (job->output_file == NULL) || ( (output_file_ptr = open_output(job->output_file)) == NULL ) )
+	{
+		batch_fail(job,"\n Error opening file");
+	}
+	else if( !put_code(output_file_ptr,job->out.data,job->out.size) )
+	{
+		batch_fail(job,"\n Error writing file");
+	}
+	if(output_file_ptr != NULL)
+	{
+		fclose(output_file_ptr);
+	}
+	free(job->out.data);
+	job->out.data = NULL;
+}
+
+// prints everything job has to say, each line starting with its source
+void batch_report(Batch_Job *job)
+{
+	FILE *file = message_file ? message_file : stdout;
+	for(const char *line = job->out.messages;(line != NULL) && (*line != 0);)
+	{
+		const char *end = strchr(line,'\n');
+		int length = (end != NULL) ? (int)(end - line) : (int)strlen(line);
+		fprintf(file,"\n %s: %.*s",job->input_file,length,line);
+		line += length + (end != NULL);
+	}
+	fprintf(file,"\n %s:",job->input_file);
+	if(job->failed)
+	{
+		print_error(job->out.error,job->out.error_line - 1);
+	}
+	else
+	{
+		print_error(" Assembled with no Errors",-1);
+	}
+}
+
+void* batch_worker(void *arg)
+{
+	Batch *batch = arg;
+	while(1)
+	{
+		pthread_mutex_lock(&batch->lock);
+		int job = batch->next_job++;
+		pthread_mutex_unlock(&batch->lock);
+		if(job >= batch->job_count)
+		{
+			return NULL;
+		}
+		batch_run_job(&batch->jobs[job]);
+		// one source at a time, so its lines stay together
+		pthread_mutex_lock(&batch->lock);
+		batch_report(&batch->jobs[job]);
+		pthread_mutex_unlock(&batch->lock);
+		basm_output_free(&batch->jobs[job].out);
+	}
+}
+
+// returns the number of sources that failed
+int batch_assemble(char **input_files,int file_count,int thread_count)
+{
+	Batch batch;
+	pthread_t threads[BATCH_MAX_THREADS];
+	batch.jobs = calloc(file_count,sizeof(Batch_Job));
+	if(batch.jobs == NULL)
+	{
+		print_error("\n Error Out of memory ",-1);
+		return file_count;
+	}
+	batch.job_count = file_count;
+	batch.next_job = 0;
+	pthread_mutex_init(&batch.lock,NULL);
+	for(int i=0;i<file_count;i++)
+	{
+		batch.jobs[i].input_file = input_files[i];
+		batch.jobs[i].output_file = batch_output_name(input_files[i]);
+	}
+
+	if(thread_count > file_count)
+	{
+		thread_count = file_count;
+	}
+	if(thread_count > BATCH_MAX_THREADS)
+	{
+		thread_count = BATCH_MAX_THREADS;
+	}
+	int started = 0;
+	for(;started<thread_count;started++)
+	{
+		if( pthread_create(&threads[started],NULL,batch_worker,&batch) != 0 )
+		{
+			break;
+		}
+	}
+	if(started == 0)
+	{
+		batch_worker(&batch); // no threads, do the work here
+	}
+	for(int i=0;i<started;i++)
+	{
+		pthread_join(threads[i],NULL);
+	}
+	pthread_mutex_destroy(&batch.lock);
+
+	int failed = 0;
+	for(int i=0;i<file_count;i++)
+	{
+		failed += batch.jobs[i].failed;
+		free(batch.jobs[i].output_file);
+	}
+	free(batch.jobs);
+	return failed;
+}
+
+#endif
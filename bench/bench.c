@@ -0,0 +1,194 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Times each phase of the assembler on the given sources.
+//
+//	bench [-r runs] [-t threads] source.s ...
+//
+// Built from the assembler source with -DBASM_LIBRARY so the phases can be
+// called one at a time. The best of runs is reported for each phase.
+
+#include"../basm_rv.c"
+
+#include<time.h>
+#include<sys/resource.h>
+
+#define BENCH_OUTPUT	"bench_output.bin"
+
+typedef struct Bench_Times
+{
+	double	parse;		// start_parser()
+	double	finish;		// file_finish()
+	double	write;		// output file
+	double	threads;	// basm_assemble_threads(), when -t is given
+	double	cached;		// basm_assemble_cached() of the unchanged source
+}Bench_Times;
+
+double bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void bench_best(double *best,double time)
+{
+	if( (*best == 0) || (time < *best) )
+	{
+		*best = time;
+	}
+}
+
+int bench_run(Source_File *source,int threads,Bench_Times *best)
+{
+	basm_output out = {0};
+	Basm_Context *ctx = calloc(1,sizeof(Basm_Context));
+	if(ctx == NULL)
+	{
+		return FALSE;
+	}
+	init_context(ctx,source->data,source->data + source->size,&out);
+	if( setjmp(ctx->error_jump) )
+	{
+		print_error(out.error,out.error_line - 1);
+		free_context(ctx);
+		free(ctx);
+		return FALSE;
+	}
+	double start = bench_now();
+	start_parser(ctx);
+	double parsed = bench_now();
+	file_finish(ctx);
+	double finished = bench_now();
+
+	FILE *output_file_ptr = open_output(BENCH_OUTPUT);
+	if( (output_file_ptr == NULL) || !put_code(output_file_ptr,ctx->output_code.data,ctx->output_code.size) )
+	{
+		print_error("\n Error writing file",-1);
+		free_context(ctx);
+		free(ctx);
+		return FALSE;
+	}
+	fclose(output_file_ptr);
+	double written = bench_now();
+	free_context(ctx);
+	free(ctx);
+
+	bench_best(&best->parse,parsed - start);
+	bench_best(&best->finish,finished - parsed);
+	bench_best(&best->write,written - finished);
+
+	// the first call fills the cache, the second finds every region in it
+	basm_cache *cache = basm_cache_new();
+	for(int pass=0;pass<2;pass++)
+	{
+		start = bench_now();
+		if( basm_assemble_cached(cache,(const char*)source->data,source->size,&out) != 0 )
+		{
+			print_error(out.error,out.error_line - 1);
+			basm_cache_free(cache);
+			return FALSE;
+		}
+		basm_output_free(&out);
+	}
+	bench_best(&best->cached,bench_now() - start);
+	basm_cache_free(cache);
+
+	if(threads > 1)
+	{
+		start = bench_now();
+		if( basm_assemble_threads((const char*)source->data,source->size,threads,&out) != 0 )
+		{
+			print_error(out.error,out.error_line - 1);
+			return FALSE;
+		}
+		bench_best(&best->threads,bench_now() - start);
+		basm_output_free(&out);
+	}
+	return TRUE;
+}
+
+int main(int argc,char *argv[])
+{
+	int runs = 5;
+	int threads = 1;
+	int first = 1;
+	while( (first + 1 < argc) && (argv[first][0] == '-') )
+	{
+		if(strcmp(argv[first],"-r") == 0)
+		{
+			runs = atoi(argv[first+1]);
+		}
+		else if(strcmp(argv[first],"-t") == 0)
+		{
+			threads = atoi(argv[first+1]);
+		}
+		else
+		{
+			break;
+		}
+		first += 2;
+	}
+	if( (first >= argc) || (runs < 1) || (threads < 1) )
+	{
+		print_error("\n bench [-r runs] [-t threads] [source_file_name] ...\n",-1);
+		return -1;
+	}
+
+	for(int i=first;i<argc;i++)
+	{
+		Source_File source;
+		if( !load_source(argv[i],&source) )
+		{
+			print_error("\n Error opening file\n",-1);
+			return -1;
+		}
+		size_t lines = 0;
+		for(const uint8_t *ptr = source.data; (ptr = memchr(ptr,LINE_END,source.data + source.size - ptr)) != NULL; ptr++)
+		{
+			lines++;
+		}
+
+		Bench_Times best = {0};
+		for(int run=0;run<runs;run++)
+		{
+			if( !bench_run(&source,threads,&best) )
+			{
+				return -1;
+			}
+		}
+		double total = best.parse + best.finish + best.write;
+		printf("%s: %zu lines, %.1f MB\n",argv[i],lines,source.size / 1e6);
+		printf("  start_parser  %9.3f ms\n",best.parse * 1e3);
+		printf("  file_finish   %9.3f ms\n",best.finish * 1e3);
+		printf("  write         %9.3f ms\n",best.write * 1e3);
+		printf("  total         %9.3f ms  %.0f lines/sec  %.1f MB/sec\n",total * 1e3,lines / total,source.size / 1e6 / total);
+		printf("  cached        %9.3f ms  rebuild with no changes\n",best.cached * 1e3);
+		if(threads > 1)
+		{
+			printf("  -t %-3i        %9.3f ms  %.0f lines/sec  %.1f MB/sec\n",threads,best.threads * 1e3,lines / best.threads,source.size / 1e6 / best.threads);
+		}
+		release_source(&source);
+	}
+	remove(BENCH_OUTPUT);
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF,&usage);
+	printf("peak RSS %ld KB\n",usage.ru_maxrss);
+	return 0;
+}
@@ -0,0 +1,178 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Writes a synthetic source for benchmarking basm_rv.
+//
+//	gen_source [options] > big.s
+//		-n lines		number of lines (default 1000000)
+//		-l percent		label lines
+//		-f percent		ops that use a label ahead of them (forward references)
+//		-b percent		ops that use a label behind them
+//		-k percent		ops that use an @const
+//		-c percent		comment lines
+//		-d percent		$ data lines
+//		-s seed
+//
+// Everything else is plain R and I type ops. Label references stay a few
+// labels away so the offsets fit and the assembler prints no warnings.
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+
+#define GEN_CONSTS			256
+#define GEN_REACH			4	// labels ahead or behind a reference may go
+
+static uint64_t gen_state = 88172645463325252ull;
+
+uint32_t gen_random(void)
+{
+	// xorshift64
+	gen_state ^= gen_state << 13;
+	gen_state ^= gen_state >> 7;
+	gen_state ^= gen_state << 17;
+	return gen_state >> 32;
+}
+
+uint32_t gen_range(uint32_t n)
+{
+	return gen_random() % n;
+}
+
+const char *gen_r_ops[] = {"ADD","SUB","XOR","OR","AND","SLL","SRL","SRA","SLT","SLTU","MUL","DIVU","REMW","ADDW"};
+const char *gen_i_ops[] = {"ADDI","ANDI","ORI","XORI","SLTI","LW","LD","LBU","ADDIW"};
+const char *gen_b_ops[] = {"BEQ","BNE","BLT","BGE","BLTU","BGEU"};
+const char *gen_s_ops[] = {"SB","SH","SW","SD"};
+
+#define GEN_PICK(TABLE)	TABLE[gen_range(sizeof(TABLE)/sizeof(TABLE[0]))]
+
+// an op that uses label, branches, jumps and stores in turn
+void gen_label_op(uint32_t label)
+{
+	switch(gen_range(3))
+	{
+		case 0:
+			printf("\t%s x%u, x%u, >L%u\n",GEN_PICK(gen_b_ops),gen_range(32),gen_range(32),label);
+			break;
+		case 1:
+			printf("\tJAL x%u, >L%u\n",gen_range(32),label);
+			break;
+		default:
+			printf("\t%s x%u, x%u, >L%u\n",GEN_PICK(gen_s_ops),gen_range(32),gen_range(32),label);
+			break;
+	}
+}
+
+int main(int argc,char *argv[])
+{
+	uint32_t lines = 1000000;
+	uint32_t label_pct = 8;
+	uint32_t forward_pct = 15;
+	uint32_t backward_pct = 10;
+	uint32_t const_pct = 10;
+	uint32_t comment_pct = 10;
+	uint32_t data_pct = 3;
+
+	for(int i=1;i<argc;i++)
+	{
+		if( (argv[i][0] != '-') || (i+1 >= argc) )
+		{
+			fprintf(stderr,"gen_source [-n lines] [-l -f -b -k -c -d percent] [-s seed]\n");
+			return -1;
+		}
+		uint32_t value = strtoul(argv[i+1],NULL,10);
+		switch(argv[i][1])
+		{
+			case 'n': lines = value; break;
+			case 'l': label_pct = value; break;
+			case 'f': forward_pct = value; break;
+			case 'b': backward_pct = value; break;
+			case 'k': const_pct = value; break;
+			case 'c': comment_pct = value; break;
+			case 'd': data_pct = value; break;
+			case 's': gen_state = gen_state ^ ( (uint64_t)value * 0x9e3779b97f4a7c15ull ); break;
+			default:
+				fprintf(stderr,"gen_source unknown option %s\n",argv[i]);
+				return -1;
+		}
+		i++;
+	}
+
+	for(uint32_t i=0;i<GEN_CONSTS;i++)
+	{
+		printf("@K%u [%x]\n",i,gen_range(0x7ff));
+	}
+
+	uint32_t labels = 0;
+	for(uint32_t line=GEN_CONSTS;line<lines;line++)
+	{
+		uint32_t pick = gen_range(100);
+		if( pick < label_pct )
+		{
+			printf(":L%u:\n",labels++);
+			continue;
+		}
+		pick -= label_pct;
+		if( pick < forward_pct )
+		{
+			gen_label_op(labels + gen_range(GEN_REACH));
+			continue;
+		}
+		pick -= forward_pct;
+		if( pick < backward_pct )
+		{
+			uint32_t back = gen_range(GEN_REACH) + 1;
+			gen_label_op(labels > back ? labels - back : labels);
+			continue;
+		}
+		pick -= backward_pct;
+		if( pick < const_pct )
+		{
+			printf("\t%s x%u, x%u, @K%u\n",GEN_PICK(gen_i_ops),gen_range(32),gen_range(32),gen_range(GEN_CONSTS));
+			continue;
+		}
+		pick -= const_pct;
+		if( pick < comment_pct )
+		{
+			printf("# %u comment text that the assembler has to skip over, as real sources have plenty of it\n",line);
+			continue;
+		}
+		pick -= comment_pct;
+		if( pick < data_pct )
+		{
+			printf("$ [%x]\n",gen_random());
+			continue;
+		}
+		if( gen_range(2) )
+		{
+			printf("\t%s x%u, x%u, x%u\t# op\n",GEN_PICK(gen_r_ops),gen_range(32),gen_range(32),gen_range(32));
+		}
+		else
+		{
+			printf("\t%s x%u, x%u, %x\n",GEN_PICK(gen_i_ops),gen_range(32),gen_range(32),gen_range(0x7ff));
+		}
+	}
+	// every forward reference lands somewhere
+	for(uint32_t i=0;i<GEN_REACH;i++)
+	{
+		printf(":L%u:\n",labels++);
+	}
+	printf("\tADD x0, x0, x0\n");
+	return 0;
+}
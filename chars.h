@@ -0,0 +1,109 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHARS_H_
+#define CHARS_H_
+
+#include<stdint.h>
+#include<string.h>
+
+// One table load gives the class of a char, its hex value and its upper case.
+
+#define CHAR_DIGIT		0x01	// 0-9
+#define CHAR_UPPER		0x02	// A-Z
+#define CHAR_LOWER		0x04	// a-z
+#define CHAR_HEX		0x08	// 0-9 A-F a-f
+#define CHAR_BLANK		0x10	// space and tab
+#define CHAR_PERIOD		0x20	// .
+
+#define CHAR_LETTER		(CHAR_UPPER | CHAR_LOWER)
+#define CHAR_NAME		(CHAR_DIGIT | CHAR_LETTER)	// label and const names
+#define CHAR_OP_NAME	(CHAR_PERIOD | CHAR_LETTER)	// op names
+
+typedef struct Char_Class
+{
+	uint8_t		flags;
+	uint8_t		hex;	// value of a hex digit
+	uint8_t		upper;	// upper case of a letter, only set for CHAR_OP_NAME chars
+	uint8_t		pad;
+}Char_Class;
+
+#define CHAR_ROW(C,FLAGS,HEX,UPPER)	[C] = { (FLAGS), (HEX), (UPPER), 0 }
+#define CHAR_DIGIT_ROW(C)			CHAR_ROW(C, CHAR_DIGIT | CHAR_HEX, (C) - '0', 0)
+#define CHAR_UPPER_ROW(C)			CHAR_ROW(C, CHAR_UPPER, 0, C)
+#define CHAR_LOWER_ROW(C)			CHAR_ROW(C, CHAR_LOWER, 0, (C) - 32)
+#define CHAR_UPPER_HEX_ROW(C)		CHAR_ROW(C, CHAR_UPPER | CHAR_HEX, (C) - 'A' + 10, C)
+#define CHAR_LOWER_HEX_ROW(C)		CHAR_ROW(C, CHAR_LOWER | CHAR_HEX, (C) - 'a' + 10, (C) - 32)
+
+static const _Alignas(64) Char_Class char_class[256] =
+{
+	CHAR_ROW(' ', CHAR_BLANK, 0, 0),
+	CHAR_ROW('\t', CHAR_BLANK, 0, 0),
+	CHAR_ROW('.', CHAR_PERIOD, 0, '.'),
+
+	CHAR_DIGIT_ROW('0'), CHAR_DIGIT_ROW('1'), CHAR_DIGIT_ROW('2'), CHAR_DIGIT_ROW('3'), CHAR_DIGIT_ROW('4'),
+	CHAR_DIGIT_ROW('5'), CHAR_DIGIT_ROW('6'), CHAR_DIGIT_ROW('7'), CHAR_DIGIT_ROW('8'), CHAR_DIGIT_ROW('9'),
+
+	CHAR_UPPER_HEX_ROW('A'), CHAR_UPPER_HEX_ROW('B'), CHAR_UPPER_HEX_ROW('C'),
+	CHAR_UPPER_HEX_ROW('D'), CHAR_UPPER_HEX_ROW('E'), CHAR_UPPER_HEX_ROW('F'),
+	CHAR_UPPER_ROW('G'), CHAR_UPPER_ROW('H'), CHAR_UPPER_ROW('I'), CHAR_UPPER_ROW('J'), CHAR_UPPER_ROW('K'),
+	CHAR_UPPER_ROW('L'), CHAR_UPPER_ROW('M'), CHAR_UPPER_ROW('N'), CHAR_UPPER_ROW('O'), CHAR_UPPER_ROW('P'),
+	CHAR_UPPER_ROW('Q'), CHAR_UPPER_ROW('R'), CHAR_UPPER_ROW('S'), CHAR_UPPER_ROW('T'), CHAR_UPPER_ROW('U'),
+	CHAR_UPPER_ROW('V'), CHAR_UPPER_ROW('W'), CHAR_UPPER_ROW('X'), CHAR_UPPER_ROW('Y'), CHAR_UPPER_ROW('Z'),
+
+	CHAR_LOWER_HEX_ROW('a'), CHAR_LOWER_HEX_ROW('b'), CHAR_LOWER_HEX_ROW('c'),
+	CHAR_LOWER_HEX_ROW('d'), CHAR_LOWER_HEX_ROW('e'), CHAR_LOWER_HEX_ROW('f'),
+	CHAR_LOWER_ROW('g'), CHAR_LOWER_ROW('h'), CHAR_LOWER_ROW('i'), CHAR_LOWER_ROW('j'), CHAR_LOWER_ROW('k'),
+	CHAR_LOWER_ROW('l'), CHAR_LOWER_ROW('m'), CHAR_LOWER_ROW('n'), CHAR_LOWER_ROW('o'), CHAR_LOWER_ROW('p'),
+	CHAR_LOWER_ROW('q'), CHAR_LOWER_ROW('r'), CHAR_LOWER_ROW('s'), CHAR_LOWER_ROW('t'), CHAR_LOWER_ROW('u'),
+	CHAR_LOWER_ROW('v'), CHAR_LOWER_ROW('w'), CHAR_LOWER_ROW('x'), CHAR_LOWER_ROW('y'), CHAR_LOWER_ROW('z'),
+};
+
+#define CHAR_IS(C,FLAGS)	(char_class[(uint8_t)(C)].flags & (FLAGS))
+
+#define HEX_WORD_DIGITS		8
+
+// Value of length (1 to 8) hex digits, end is the end of the buffer holding them.
+// The digits are loaded as one word with the last digit in the top byte, then
+// turned into nibbles and folded together pair by pair with shifts and masks.
+static inline uint32_t hex_value(const uint8_t *digits,int length,const uint8_t *end)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	uint64_t word = 0;
+	memcpy(&word,digits,(end - digits >= HEX_WORD_DIGITS) ? HEX_WORD_DIGITS : length);
+	word = word << ( (HEX_WORD_DIGITS - length) * 8 );	// zero bytes in front are leading zeros
+	// 0-9 keep their low nibble, letters have bit 6 set and need 9 added
+	uint64_t letter = (word >> 6) & 0x0101010101010101ull;
+	word = (word & 0x0f0f0f0f0f0f0f0full) + letter * 9;
+	// the first digit is in the lowest byte, join neighbours into bytes, then 16 and 32 bits
+	word = ( (word & 0x000f000f000f000full) << 4 ) | ( (word >> 8) & 0x000f000f000f000full );
+	word = ( (word & 0x000000ff000000ffull) << 8 ) | ( (word >> 16) & 0x000000ff000000ffull );
+	word = ( (word & 0x000000000000ffffull) << 16 ) | ( (word >> 32) & 0x000000000000ffffull );
+	return (uint32_t)word;
+#else
+	uint32_t number = 0;
+	for(int i = 0;i<length;i++)
+	{
+		number = (number << 4) | char_class[digits[i]].hex;
+	}
+	(void)end;
+	return number;
+#endif
+}
+
+#endif
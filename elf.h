@@ -0,0 +1,170 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef ELF_H_
+#define ELF_H_
+
+#include<stdio.h>
+#include<stdint.h>
+
+// The parts of ELF64 needed to wrap the image for RISC-V, little endian only.
+// The file is laid out in the order it is written:
+//
+//	header, program header (executable only), .text, .data,
+//	.symtab, .strtab, .shstrtab, .rela.text (relocatable only), section headers
+
+#define ELF_CLASS64			2
+#define ELF_DATA_LSB		1
+#define ELF_VERSION			1
+#define ELF_MACHINE_RISCV	243
+#define ELF_FLAG_RVC		0x1		// the file holds compressed ops
+
+#define ELF_TYPE_REL		1
+#define ELF_TYPE_EXEC		2
+
+#define ELF_BASE_ADDRESS	0x10000	// where an executable image is loaded
+#define ELF_PAGE_SIZE		0x1000	// an executable image starts on a page in the file
+
+#define ELF_SECTION_NULL		0
+#define ELF_SECTION_TEXT		1
+#define ELF_SECTION_DATA		2
+#define ELF_SECTION_SYMTAB		3
+#define ELF_SECTION_STRTAB		4
+#define ELF_SECTION_SHSTRTAB	5
+#define ELF_SECTION_RELA		6	// relocatable only
+
+#define ELF_SHT_PROGBITS	1
+#define ELF_SHT_SYMTAB		2
+#define ELF_SHT_STRTAB		3
+#define ELF_SHT_RELA		4
+
+#define ELF_SHF_WRITE		0x1
+#define ELF_SHF_ALLOC		0x2
+#define ELF_SHF_EXEC		0x4
+#define ELF_SHF_INFO_LINK	0x40
+
+#define ELF_PT_LOAD			1
+#define ELF_PF_RWX			0x7
+
+#define ELF_SYMBOL(BIND,TYPE)	( ((BIND) << 4) | (TYPE) )
+#define ELF_STB_LOCAL		0
+#define ELF_STB_GLOBAL		1
+#define ELF_STT_NOTYPE		0
+#define ELF_STT_SECTION		3
+#define ELF_SHN_UNDEF		0
+
+#define ELF_FIRST_LABEL_SYMBOL	3	// null, .text and .data come first
+
+#define ELF_R_RISCV_BRANCH	16
+#define ELF_R_RISCV_JAL		17
+#define ELF_R_INFO(SYMBOL,TYPE)	( ((uint64_t)(SYMBOL) << 32) | (TYPE) )
+
+// names in .shstrtab, each offset is where the name starts
+#define ELF_SECTION_NAMES	"\0.text\0.data\0.symtab\0.strtab\0.shstrtab\0.rela.text"
+#define ELF_NAME_TEXT		1
+#define ELF_NAME_DATA		7
+#define ELF_NAME_SYMTAB		13
+#define ELF_NAME_STRTAB		21
+#define ELF_NAME_SHSTRTAB	29
+#define ELF_NAME_RELA		39
+
+typedef struct Elf_Header
+{
+	uint8_t		ident[16];
+	uint16_t	type;
+	uint16_t	machine;
+	uint32_t	version;
+	uint64_t	entry;
+	uint64_t	program_header_offset;
+	uint64_t	section_header_offset;
+	uint32_t	flags;
+	uint16_t	header_size;
+	uint16_t	program_header_size;
+	uint16_t	program_header_count;
+	uint16_t	section_header_size;
+	uint16_t	section_header_count;
+	uint16_t	section_names;		// index of .shstrtab
+}Elf_Header;
+
+typedef struct Elf_Program_Header
+{
+	uint32_t	type;
+	uint32_t	flags;
+	uint64_t	offset;
+	uint64_t	address;
+	uint64_t	physical_address;
+	uint64_t	file_size;
+	uint64_t	memory_size;
+	uint64_t	align;
+}Elf_Program_Header;
+
+typedef struct Elf_Section_Header
+{
+	uint32_t	name;
+	uint32_t	type;
+	uint64_t	flags;
+	uint64_t	address;
+	uint64_t	offset;
+	uint64_t	size;
+	uint32_t	link;
+	uint32_t	info;
+	uint64_t	align;
+	uint64_t	entry_size;
+}Elf_Section_Header;
+
+typedef struct Elf_Symbol
+{
+	uint32_t	name;
+	uint8_t		info;
+	uint8_t		other;
+	uint16_t	section;
+	uint64_t	value;
+	uint64_t	size;
+}Elf_Symbol;
+
+typedef struct Elf_Rela
+{
+	uint64_t	offset;
+	uint64_t	info;
+	int64_t		addend;
+}Elf_Rela;
+
+// rounds up to a power of two
+#define ELF_ALIGN(N,A)		( ((N) + (A) - 1) & ~(uint64_t)((A) - 1) )
+
+// zeros up to offset, returns 0 on a write error
+int elf_pad(FILE *file,uint64_t *position,uint64_t offset)
+{
+	for(;*position < offset;(*position)++)
+	{
+		if(fputc(0,file) == EOF)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// returns 0 on a write error
+int elf_put(FILE *file,uint64_t *position,const void *data,size_t size)
+{
+	*position += size;
+	return (size == 0) || (fwrite(data,1,size,file) == size);
+}
+
+#endif
@@ -42,8 +42,9 @@
 // J_Type defs
 #define JBIT20	0b10000000000000000000
 #define JBIT11	0b10000000000
-#define JBIT_20_11 (JBIT20 & JBIT11)
+#define JBIT_20_11 (JBIT20 | JBIT11)
 #define JAND11	0b11111111111
+#define JAND20	0b11111111111111111111
 //
 
 // S_Type defs
@@ -125,7 +126,7 @@ CODE32 B_Type(OFF12 p5,REG5 p4,REG5 p3,FUN3 p2,OP7 p0)
 	
 	// seperate p5 into two perameters.
 	OFF12 p1 = ((p5 & B_AND4)<<1)+ bit11 ;
-	p5 =( ((bit12)<<7)  + ( ((p5)>>4 )& B_AND6) );
+	p5 =( ((bit12)<<6)  + ( ((p5)>>4 )& B_AND6) );
 
 	
 	CODE32 code =0;
@@ -138,7 +139,7 @@ CODE32 J_Type(OFF20 p2,REG5 p1, OP7 p0)
 	ANDCLEAR(p0,KEEP7);
 	ANDCLEAR(p1,KEEP5);
 
-	p2 = ((p2)>>1);
+	p2 = ((p2)>>1) & JAND20;	// drop the sign bits above bit 20 of a negative offset
 	// swap bits 20 and 11
 	uint32_t  bit20 = (p2 & JBIT20) && 1 ;
 	uint32_t  bit11  = (p2 & JBIT11) && 1  ;
@@ -185,4 +186,220 @@ CODE32 U_Type(IMM20 p2,REG5 p1, OP7 p0)
 }
 
 
+// ---- RVC
+// C_Compress() takes an op already encoded by the functions above and gives
+// the RV64C form with the same effect, or 0 when there is none. Working from
+// the 32 bit word keeps one place that knows the 16 bit formats.
+
+#define CODE16	uint16_t
+
+// bits HI to LO of V moved down to bit 0, then up to bit AT
+#define C_BITS(V,HI,LO)			( ((uint32_t)(V) >> (LO)) & ((1u << ((HI) - (LO) + 1)) - 1) )
+#define C_PUT(V,HI,LO,AT)		( C_BITS(V,HI,LO) << (AT) )
+#define C_REG(R)				( ((R) & ~7u) == 8 )	// x8 - x15, the registers the 3 bit fields reach
+#define C_FITS(V,MIN,MAX)		( ((V) >= (MIN)) && ((V) <= (MAX)) )
+
+#define C_OP_CODE_SIZE	2
+#define C_NOP			0x0001
+
+#define OPCODE_LOAD		0b0000011
+#define OPCODE_OP_IMM	0b0010011
+#define OPCODE_OP_IMM_32	0b0011011
+#define OPCODE_STORE	0b0100011
+#define OPCODE_OP		0b0110011
+#define OPCODE_LUI		0b0110111
+#define OPCODE_AUIPC	0b0010111
+#define OPCODE_OP_32	0b0111011
+#define OPCODE_BRANCH	0b1100011
+#define OPCODE_JALR		0b1100111
+#define OPCODE_JAL		0b1101111
+
+// quadrant 0 and 1 ops on x8 - x15, r is the full register number
+#define C_CIW(F3,IMM8,RD)		( ((F3) << 13) | ((IMM8) << 5) | (((RD) - 8) << 2) )
+#define C_CL(F3,IMM,RS1,RD)		( ((F3) << 13) | (IMM) | (((RS1) - 8) << 7) | (((RD) - 8) << 2) )
+#define C_CA(F6,F2,RD,RS2)		( ((F6) << 10) | (((RD) - 8) << 7) | ((F2) << 5) | (((RS2) - 8) << 2) | 0b01 )
+#define C_CI(F3,IMM6,RD,Q)		( ((F3) << 13) | C_PUT(IMM6,5,5,12) | ((RD) << 7) | C_PUT(IMM6,4,0,2) | (Q) )
+
+CODE16 C_Compress(CODE32 code)
+{
+	uint32_t	op	= code & 0x7f;
+	uint32_t	rd	= C_BITS(code,11,7);
+	uint32_t	fun3	= C_BITS(code,14,12);
+	uint32_t	rs1	= C_BITS(code,19,15);
+	uint32_t	rs2	= C_BITS(code,24,20);
+	uint32_t	fun7	= C_BITS(code,31,25);
+	int32_t		imm_i	= (int32_t)code >> 20;
+	int32_t		imm_s	= ( ((int32_t)code >> 25) << 5 ) | (int32_t)rd;
+	int32_t		imm_b	= ( ((int32_t)code >> 31) << 12 ) | (C_BITS(code,7,7) << 11) | (C_BITS(code,30,25) << 5) | (C_BITS(code,11,8) << 1);
+	int32_t		imm_j	= ( ((int32_t)code >> 31) << 20 ) | (C_BITS(code,19,12) << 12) | (C_BITS(code,20,20) << 11) | (C_BITS(code,30,21) << 1);
+	int32_t		imm_u	= (int32_t)(code & 0xfffff000) >> 12;
+
+	switch(op)
+	{
+		case OPCODE_OP:
+			if( (fun7 == 0) && (fun3 == 0) && (rd != 0) && (rs2 != 0) )
+			{
+				if(rs1 == 0)
+				{
+					return 0x8002 | (rd << 7) | (rs2 << 2);					// c.mv
+				}
+				if(rs1 == rd)
+				{
+					return 0x9002 | (rd << 7) | (rs2 << 2);					// c.add
+				}
+			}
+			if( (rd == rs1) && C_REG(rd) && C_REG(rs2) )
+			{
+				if( (fun7 == 0b0100000) && (fun3 == 0b000) ) return C_CA(0b100011,0b00,rd,rs2);	// c.sub
+				if( (fun7 == 0) && (fun3 == 0b100) ) return C_CA(0b100011,0b01,rd,rs2);		// c.xor
+				if( (fun7 == 0) && (fun3 == 0b110) ) return C_CA(0b100011,0b10,rd,rs2);		// c.or
+				if( (fun7 == 0) && (fun3 == 0b111) ) return C_CA(0b100011,0b11,rd,rs2);		// c.and
+			}
+			return 0;
+
+		case OPCODE_OP_32:
+			if( (rd == rs1) && C_REG(rd) && C_REG(rs2) && (fun3 == 0) )
+			{
+				if(fun7 == 0b0100000) return C_CA(0b100111,0b00,rd,rs2);	// c.subw
+				if(fun7 == 0) return C_CA(0b100111,0b01,rd,rs2);			// c.addw
+			}
+			return 0;
+
+		case OPCODE_OP_IMM:
+			if(fun3 == 0b000)	// addi
+			{
+				if( (rd == 0) && (rs1 == 0) && (imm_i == 0) )
+				{
+					return C_NOP;
+				}
+				if( (rd != 0) && (rs1 == 0) && C_FITS(imm_i,-32,31) )
+				{
+					return C_CI(0b010,imm_i,rd,0b01);						// c.li
+				}
+				if( (rd != 0) && (rd == rs1) && (imm_i != 0) && C_FITS(imm_i,-32,31) )
+				{
+					return C_CI(0b000,imm_i,rd,0b01);						// c.addi
+				}
+				if( (rd == 2) && (rs1 == 2) && (imm_i != 0) && ((imm_i & 0xf) == 0) && C_FITS(imm_i,-512,496) )
+				{
+					return 0x6000 | C_PUT(imm_i,9,9,12) | (2 << 7) | C_PUT(imm_i,4,4,6) | C_PUT(imm_i,6,6,5)
+						| C_PUT(imm_i,8,7,3) | C_PUT(imm_i,5,5,2) | 0b01;	// c.addi16sp
+				}
+				if( (rs1 == 2) && C_REG(rd) && ((imm_i & 0x3) == 0) && C_FITS(imm_i,4,1020) )
+				{
+					return C_CIW(0b000,C_PUT(imm_i,5,4,6) | C_PUT(imm_i,9,6,2) | C_PUT(imm_i,2,2,1) | C_PUT(imm_i,3,3,0),rd);	// c.addi4spn
+				}
+				if( (rd != 0) && (rs1 != 0) && (imm_i == 0) )
+				{
+					return 0x8002 | (rd << 7) | (rs1 << 2);					// c.mv
+				}
+				return 0;
+			}
+			if( (fun3 == 0b001) && (rd != 0) && (rd == rs1) && (C_BITS(code,31,26) == 0) && (rs2 | C_BITS(code,25,25)) )
+			{
+				return C_CI(0b000,C_BITS(code,25,20),rd,0b10);				// c.slli
+			}
+			if( (fun3 == 0b101) && C_REG(rd) && (rd == rs1) && (rs2 | C_BITS(code,25,25)) )
+			{
+				uint32_t shamt = C_BITS(code,25,20);
+				if(C_BITS(code,31,26) == 0b000000) return 0x8001 | C_PUT(shamt,5,5,12) | (0b00 << 10) | ((rd - 8) << 7) | C_PUT(shamt,4,0,2);	// c.srli
+				if(C_BITS(code,31,26) == 0b010000) return 0x8001 | C_PUT(shamt,5,5,12) | (0b01 << 10) | ((rd - 8) << 7) | C_PUT(shamt,4,0,2);	// c.srai
+				return 0;
+			}
+			if( (fun3 == 0b111) && C_REG(rd) && (rd == rs1) && C_FITS(imm_i,-32,31) )
+			{
+				return 0x8001 | C_PUT(imm_i,5,5,12) | (0b10 << 10) | ((rd - 8) << 7) | C_PUT(imm_i,4,0,2);	// c.andi
+			}
+			return 0;
+
+		case OPCODE_OP_IMM_32:
+			if( (fun3 == 0) && (rd != 0) && (rd == rs1) && C_FITS(imm_i,-32,31) )
+			{
+				return C_CI(0b001,imm_i,rd,0b01);							// c.addiw
+			}
+			return 0;
+
+		case OPCODE_LOAD:
+			if( (fun3 == 0b010) && ((imm_i & 0x3) == 0) )	// lw
+			{
+				if( (rs1 == 2) && (rd != 0) && C_FITS(imm_i,0,252) )
+				{
+					return 0x4002 | C_PUT(imm_i,5,5,12) | (rd << 7) | C_PUT(imm_i,4,2,4) | C_PUT(imm_i,7,6,2);	// c.lwsp
+				}
+				if( C_REG(rs1) && C_REG(rd) && C_FITS(imm_i,0,124) )
+				{
+					return C_CL(0b010,C_PUT(imm_i,5,3,10) | C_PUT(imm_i,2,2,6) | C_PUT(imm_i,6,6,5),rs1,rd);	// c.lw
+				}
+			}
+			if( (fun3 == 0b011) && ((imm_i & 0x7) == 0) )	// ld
+			{
+				if( (rs1 == 2) && (rd != 0) && C_FITS(imm_i,0,504) )
+				{
+					return 0x6002 | C_PUT(imm_i,5,5,12) | (rd << 7) | C_PUT(imm_i,4,3,5) | C_PUT(imm_i,8,6,2);	// c.ldsp
+				}
+				if( C_REG(rs1) && C_REG(rd) && C_FITS(imm_i,0,248) )
+				{
+					return C_CL(0b011,C_PUT(imm_i,5,3,10) | C_PUT(imm_i,7,6,5),rs1,rd);	// c.ld
+				}
+			}
+			return 0;
+
+		case OPCODE_STORE:
+			if( (fun3 == 0b010) && ((imm_s & 0x3) == 0) )	// sw
+			{
+				if( (rs1 == 2) && C_FITS(imm_s,0,252) )
+				{
+					return 0xc002 | C_PUT(imm_s,5,2,9) | C_PUT(imm_s,7,6,7) | (rs2 << 2);	// c.swsp
+				}
+				if( C_REG(rs1) && C_REG(rs2) && C_FITS(imm_s,0,124) )
+				{
+					return C_CL(0b110,C_PUT(imm_s,5,3,10) | C_PUT(imm_s,2,2,6) | C_PUT(imm_s,6,6,5),rs1,rs2);	// c.sw
+				}
+			}
+			if( (fun3 == 0b011) && ((imm_s & 0x7) == 0) )	// sd
+			{
+				if( (rs1 == 2) && C_FITS(imm_s,0,504) )
+				{
+					return 0xe002 | C_PUT(imm_s,5,3,10) | C_PUT(imm_s,8,6,7) | (rs2 << 2);	// c.sdsp
+				}
+				if( C_REG(rs1) && C_REG(rs2) && C_FITS(imm_s,0,248) )
+				{
+					return C_CL(0b111,C_PUT(imm_s,5,3,10) | C_PUT(imm_s,7,6,5),rs1,rs2);	// c.sd
+				}
+			}
+			return 0;
+
+		case OPCODE_BRANCH:
+			if( (fun3 <= 0b001) && (rs2 == 0) && C_REG(rs1) && C_FITS(imm_b,-256,254) )
+			{
+				return ((0b110 | fun3) << 13) | C_PUT(imm_b,8,8,12) | C_PUT(imm_b,4,3,10) | ((rs1 - 8) << 7)
+					| C_PUT(imm_b,7,6,5) | C_PUT(imm_b,2,1,3) | C_PUT(imm_b,5,5,2) | 0b01;	// c.beqz, c.bnez
+			}
+			return 0;
+
+		case OPCODE_JAL:
+			if( (rd == 0) && C_FITS(imm_j,-2048,2046) )
+			{
+				return 0xa001 | C_PUT(imm_j,11,11,12) | C_PUT(imm_j,4,4,11) | C_PUT(imm_j,9,8,9) | C_PUT(imm_j,10,10,8)
+					| C_PUT(imm_j,6,6,7) | C_PUT(imm_j,7,7,6) | C_PUT(imm_j,3,1,3) | C_PUT(imm_j,5,5,2);	// c.j
+			}
+			return 0;
+
+		case OPCODE_JALR:
+			if( (fun3 == 0) && (imm_i == 0) && (rs1 != 0) && (rd <= 1) )
+			{
+				return 0x8002 | (rd << 12) | (rs1 << 7);						// c.jr, c.jalr
+			}
+			return 0;
+
+		case OPCODE_LUI:
+			if( (rd != 0) && (rd != 2) && (imm_u != 0) && C_FITS(imm_u,-32,31) )
+			{
+				return C_CI(0b011,imm_u,rd,0b01);							// c.lui
+			}
+			return 0;
+	}
+	return 0;
+}
+
 #endif
@@ -19,91 +19,167 @@
 #include<stdio.h>
 #include<stdlib.h>
 #include<stdint.h>
+#include<string.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP	1
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#endif
 
-FILE* input_file_ptr;
-FILE* output_file_ptr;
+#define SOURCE_READ_CHUNK	(1<<20)	// read size used when the source can not be mapped
 
+// where print_error() writes, NULL for stdout. Set to stderr when the binary goes to stdout.
+FILE *message_file = NULL;
 
-int init_files(char *input_file,char *output_file)
+void print_error(char *error,int source_code_number);
+
+
+// The whole source file is held in memory and handed to the assembler as one buffer.
+typedef struct Source_File
 {
+	const uint8_t*	data;
+	size_t			size;
+	size_t			mapped_length;	// non zero if data came from mmap()
+}Source_File;
 
 
-	input_file_ptr = fopen(input_file,"rb");
-	if(input_file_ptr== NULL)
-	{
-		exit(-1);
-		//return 0;
-	}
-	output_file_ptr = fopen(output_file,"wb+");
-	if(output_file_ptr == NULL)
+// Fallback for systems without mmap or for inputs that can not be mapped (pipes).
+int read_source(FILE *file,Source_File *source)
+{
+	size_t size = 0;
+	size_t capacity = 0;
+	uint8_t *buffer = NULL;
+	while(1)
 	{
-		exit(-1);
-		//return 0;
+		if( (capacity - size) < SOURCE_READ_CHUNK )
+		{
+			capacity = capacity ? capacity*2 : SOURCE_READ_CHUNK;
+			uint8_t *grown = realloc(buffer,capacity);
+			if(grown == NULL)
+			{
+				free(buffer);
+				return 0;
+			}
+			buffer = grown;
+		}
+		size_t got = fread(&buffer[size],sizeof(uint8_t),capacity - size,file);
+		size += got;
+		if(got == 0)
+		{
+			if(ferror(file))
+			{
+				print_error("\n ERROR: Unexpected file error? \n",-1);
+				free(buffer);
+				return 0;
+			}
+			break;
+		}
 	}
-	return 1;	
+	source->data = buffer;
+	source->size = size;
+	source->mapped_length = 0;
+	return 1;
 }
 
-void reopen_for_update(char *output_file)
+int load_source(char *input_file,Source_File *source)
 {
-	fclose(output_file_ptr);
-	output_file_ptr = fopen(output_file,"rb+");
-	if(output_file_ptr == NULL)
+#ifdef HAVE_MMAP
+	int fd = open(input_file,O_RDONLY);
+	if(fd < 0)
+	{
+		return 0;
+	}
+	struct stat st;
+	if( (fstat(fd,&st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0) )
+	{
+		void *map = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+		if(map != MAP_FAILED)
+		{
+			madvise(map,st.st_size,MADV_SEQUENTIAL);
+			close(fd);
+			source->data = map;
+			source->size = st.st_size;
+			source->mapped_length = st.st_size;
+			return 1;
+		}
+	}
+	close(fd);
+#endif
+	FILE *file = fopen(input_file,"rb");
+	if(file == NULL)
 	{
-		exit(-1);
-		//return 0;
+		return 0;
 	}
-	
+	int loaded = read_source(file,source);
+	fclose(file);
+	return loaded;
 }
 
-int set_code_pos(int pos)
+// the directory of the source at path, where its $f paths are read from. NULL
+// when path has no directory part, they are then read from the current one.
+// Release with free().
+char* source_dir(const char *path)
 {
-	if(fseek(output_file_ptr,pos,SEEK_SET))
+	const char *slash = strrchr(path,'/');
+	if(slash == NULL)
 	{
-		exit(-1);
+		return NULL;
 	}
-	return 0;
-}
-	
-int put_code(uint32_t op_code)
-{
-	if( fwrite(&op_code,sizeof(uint32_t),1,output_file_ptr )!=1 )
+	size_t length = (slash == path) ? 1 : (size_t)(slash - path);	// "/a.s" is in "/"
+	char *dir = malloc(length + 1);
+	if(dir != NULL)
 	{
-		// error
-		exit(-1);
+		memcpy(dir,path,length);
+		dir[length] = 0;
 	}
-	return 1;
+	return dir;
 }
 
-int get_char(uint8_t* source_char)
+void release_source(Source_File *source)
 {
-	if( fread(source_char,sizeof(uint8_t),1,input_file_ptr)!=1 )
+#ifdef HAVE_MMAP
+	if(source->mapped_length)
 	{
-		if(feof(input_file_ptr)!=0)
-		{
-			clearerr(input_file_ptr);
-			return 0;	
-		}
-		// print error msg
-		// exit
-		printf("\n ERROR: Unexpected file error? \n");
-		exit(-1);
+		munmap((void*)source->data,source->mapped_length);
+		source->data = NULL;
+		source->mapped_length = 0;
+		return;
 	}
-	return 1;
+#endif
+	free((void*)source->data);
+	source->data = NULL;
+}
+
+FILE* open_output(char *output_file)
+{
+	return fopen(output_file,"wb");
 }
 
-void close_files()
+// The binary is built in memory and written out with a single call once all labels are filled in.
+int put_code(FILE *output_file_ptr,const uint8_t *code,size_t size)
 {
-	fclose(input_file_ptr);
-	fclose(output_file_ptr);
+	if( size && (fwrite(code,sizeof(uint8_t),size,output_file_ptr)!=size) )
+	{
+		// error
+		return 0;
+	}
+	return 1;
 }
 
 void print_error(char *error,int source_code_number)
 {
-	printf(error);
+	// one printf per message so lines from worker threads do not interleave
+	FILE *file = message_file ? message_file : stdout;
 	if(source_code_number>=0)
 	{
-		printf(" - on line %i \n",source_code_number+1);
+		fprintf(file,"%s - on line %i \n",error,source_code_number+1);
+	}
+	else
+	{
+		fprintf(file,"%s",error);
 	}
 }
 
@@ -16,628 +16,174 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#define TYPE_NONE	0	// name is reserved but the op is not written yet
 #define TYPE_R	1
 #define TYPE_I	2
 #define TYPE_B	3
 #define TYPE_S	4
 #define TYPE_J	5
 #define TYPE_U	6
+#define NUMBER_OF_TYPES	7
 #define REG_INT 	120  // 'x'
 //#define REG_FLOAT 	102  // 'f'
 //#define REG_DOUBLE 	100  // 'd'
 
-#define NUMBER_OF_OPS 72
+#define NUMBER_OF_OPS 73	// ids 1 - 72, 0 is unused
 
-typedef struct Known_Parms
+// Only what the encoders need, 4 bytes per op so the whole table is a few cache lines.
+typedef struct Op_Info
 {
 	uint8_t		op_type;
-	uint8_t		pad[3];// May remove this padding later.
-	int32_t		p_known[3];
-}Known_Prams;
-
-typedef struct Op_Name
-{
-	uint8_t		length;
-	uint8_t 	name[15];
-}Op_Name;
-
-typedef struct Op_Saves
-{
-	uint8_t		op_id;
-	uint8_t		rd;
-	uint8_t		rs1;
-	uint8_t		rs2;
-	uint32_t	label_pos;
-	uint32_t	op_pos;
-}Op_Saves;
+	uint8_t		op;		// OP7
+	uint8_t		fun3;
+	uint8_t		fun7;
+}Op_Info;
 
 //			
 //			fun7			fun3   OP7
 // R-type	0000000 rs2 rs1 000 rd 0110011 					ADD 	rd, rs1, rs2
-// known[0] == p0 , known[1] == p2 , known[2] == p5 
+// op == p0 , fun3 == p2 , fun7 == p5 
 // rd == p1 , rs1 == p3 , rs2 == p4
 
 // I-type	imm[11:0] rs1 000 rd 0010011 					ADDI 	rd, rs1, imm
-// known[0] == p0 , known[1] == p2
+// op == p0 , fun3 == p2
 // rd == p1 , rs1 == p3 , imm == p4
  
 
 // B-type	imm[12|10:5] rs2 rs1 000 imm[4:1|11] 1100011 	BEQ		rs1, rs2, offset
-// known[0] == p0 , known[1] == p2 
+// op == p0 , fun3 == p2 
 // rs1 == p3 , rs2 == p4 , offset  == p5
 
 
 // S-type	imm[11:5] rs2 rs1 000 imm[4:0] 0100011 			SB 		rs2, rs1, offset	# Maybe swap for consistancy
-// known[0] == p0 , known[1] == p2 
+// op == p0 , fun3 == p2 
 // rs1 == p3 , rs2 == p4 , offset  == p5
 
 
 // J-type	imm[20|10:1|11|19:12] rd 1101111 				JAL 	rd, offset20
-// known[0] == p0
+// op == p0
 // rd == p1 , offset == p2
 
 // U-type	imm[31:12] rd 0010111 							AUIPC	rd, imm20
-// known[0] == p0
+// op == p0
 // rd == p1 , imm == p2
 
-void copy_op_name(Op_Name* op_name,const uint8_t *const_name)
+// ---- Op table
+// Every op is listed once here and the compiler builds the tables below from it.
+// Op names are packed into a 64 bit key, one char per byte starting with the
+// low byte, and OP_HASH() maps each key to its own slot in op_hash_table.
+// If a new name shares a slot with an old one op_hash_check() fails to
+// compile and OP_HASH_MUL has to be changed.
+// CSR ops still need work on their syntax, they are parsed as I-type for now.
+
+#define OP_MAX_NAME		7
+#define OP_HASH_MUL		0x7fe55e023e661e29ull
+#define OP_KEY(a,b,c,d,e,f,g)	( (uint64_t)(a) | ((uint64_t)(b)<<8) | ((uint64_t)(c)<<16) | ((uint64_t)(d)<<24) | \
+								((uint64_t)(e)<<32) | ((uint64_t)(f)<<40) | ((uint64_t)(g)<<48) )
+#define OP_HASH(key)			( (uint8_t)( ((uint64_t)(key) * OP_HASH_MUL) >> 56 ) )
+
+//  ID  name                         type       op         fun3   fun7
+#define OP_TABLE(X) \
+	X(1,  'A','D','D',0,  0,  0,  0,   TYPE_R,    0b0110011, 0b000, 0b0000000) \
+	X(2,  'A','D','D','I',0,  0,  0,   TYPE_I,    0b0010011, 0b000, 0b0000000) \
+	X(3,  'A','D','D','I','W',0,  0,   TYPE_I,    0b0011011, 0b000, 0b0000000) \
+	X(4,  'A','D','D','W',0,  0,  0,   TYPE_R,    0b0111011, 0b000, 0b0000000) \
+	X(5,  'A','N','D',0,  0,  0,  0,   TYPE_R,    0b0110011, 0b111, 0b0000000) \
+	X(6,  'A','N','D','I',0,  0,  0,   TYPE_I,    0b0010011, 0b111, 0b0000000) \
+	X(7,  'A','U','I','P','C',0,  0,   TYPE_U,    0b0010111, 0b000, 0b0000000) \
+	X(8,  'B','E','Q',0,  0,  0,  0,   TYPE_B,    0b1100011, 0b000, 0b0000000) \
+	X(9,  'B','G','E',0,  0,  0,  0,   TYPE_B,    0b1100011, 0b101, 0b0000000) \
+	X(10, 'B','G','E','U',0,  0,  0,   TYPE_B,    0b1100011, 0b111, 0b0000000) \
+	X(11, 'B','L','T',0,  0,  0,  0,   TYPE_B,    0b1100011, 0b100, 0b0000000) \
+	X(12, 'B','L','T','U',0,  0,  0,   TYPE_B,    0b1100011, 0b110, 0b0000000) \
+	X(13, 'B','N','E',0,  0,  0,  0,   TYPE_B,    0b1100011, 0b001, 0b0000000) \
+	X(14, 'C','S','R','R','C',0,  0,   TYPE_I,    0b1110011, 0b011, 0b0000000) \
+	X(15, 'C','S','R','R','C','I',0,   TYPE_I,    0b1110011, 0b111, 0b0000000) \
+	X(16, 'C','S','R','R','S',0,  0,   TYPE_I,    0b1110011, 0b010, 0b0000000) \
+	X(17, 'C','S','R','R','S','I',0,   TYPE_I,    0b1110011, 0b110, 0b0000000) \
+	X(18, 'C','S','R','R','W',0,  0,   TYPE_I,    0b1110011, 0b001, 0b0000000) \
+	X(19, 'C','S','R','R','W','I',0,   TYPE_I,    0b1110011, 0b101, 0b0000000) \
+	X(20, 'D','I','V',0,  0,  0,  0,   TYPE_R,    0b0110011, 0b100, 0b0000001) \
+	X(21, 'D','I','V','U',0,  0,  0,   TYPE_R,    0b0110011, 0b101, 0b0000001) \
+	X(22, 'D','I','V','U','W',0,  0,   TYPE_R,    0b0111011, 0b101, 0b0000001) \
+	X(23, 'D','I','V','W',0,  0,  0,   TYPE_R,    0b0111011, 0b100, 0b0000001) \
+	X(24, 'E','B','R','E','A','K',0,   TYPE_NONE, 0,         0,     0) \
+	X(25, 'E','C','A','L','L',0,  0,   TYPE_NONE, 0,         0,     0) \
+	X(26, 'F','E','N','C','E',0,  0,   TYPE_NONE, 0,         0,     0) \
+	X(27, 'F','E','N','C','E','.','I', TYPE_NONE, 0,         0,     0) \
+	X(28, 'J','A','L',0,  0,  0,  0,   TYPE_J,    0b1101111, 0b000, 0b0000000) \
+	X(29, 'J','A','L','R',0,  0,  0,   TYPE_I,    0b1100111, 0b000, 0b0000000) \
+	X(30, 'L','B',0,  0,  0,  0,  0,   TYPE_I,    0b0000011, 0b000, 0b0000000) \
+	X(31, 'L','B','U',0,  0,  0,  0,   TYPE_I,    0b0000011, 0b100, 0b0000000) \
+	X(32, 'L','D',0,  0,  0,  0,  0,   TYPE_I,    0b0000011, 0b011, 0b0000000) \
+	X(33, 'L','H',0,  0,  0,  0,  0,   TYPE_I,    0b0000011, 0b001, 0b0000000) \
+	X(34, 'L','H','U',0,  0,  0,  0,   TYPE_I,    0b0000011, 0b101, 0b0000000) \
+	X(35, 'L','U','I',0,  0,  0,  0,   TYPE_U,    0b0110111, 0b000, 0b0000000) \
+	X(36, 'L','W',0,  0,  0,  0,  0,   TYPE_I,    0b0000011, 0b010, 0b0000000) \
+	X(37, 'L','W','U',0,  0,  0,  0,   TYPE_I,    0b0000011, 0b110, 0b0000000) \
+	X(38, 'M','U','L',0,  0,  0,  0,   TYPE_R,    0b0110011, 0b000, 0b0000001) \
+	X(39, 'M','U','L','H',0,  0,  0,   TYPE_R,    0b0110011, 0b001, 0b0000001) \
+	X(40, 'M','U','L','H','S','U',0,   TYPE_R,    0b0110011, 0b010, 0b0000001) \
+	X(41, 'M','U','L','H','U',0,  0,   TYPE_R,    0b0110011, 0b011, 0b0000001) \
+	X(42, 'M','U','L','W',0,  0,  0,   TYPE_R,    0b0111011, 0b000, 0b0000001) \
+	X(43, 'O','R',0,  0,  0,  0,  0,   TYPE_R,    0b0110011, 0b110, 0b0000000) \
+	X(44, 'O','R','I',0,  0,  0,  0,   TYPE_I,    0b0010011, 0b110, 0b0000000) \
+	X(45, 'R','E','M',0,  0,  0,  0,   TYPE_R,    0b0110011, 0b110, 0b0000001) \
+	X(46, 'R','E','M','U',0,  0,  0,   TYPE_R,    0b0110011, 0b111, 0b0000001) \
+	X(47, 'R','E','M','U','W',0,  0,   TYPE_R,    0b0111011, 0b111, 0b0000001) \
+	X(48, 'R','E','M','W',0,  0,  0,   TYPE_R,    0b0111011, 0b110, 0b0000001) \
+	X(49, 'S','B',0,  0,  0,  0,  0,   TYPE_S,    0b0100011, 0b000, 0b0000000) \
+	X(50, 'S','D',0,  0,  0,  0,  0,   TYPE_S,    0b0100011, 0b011, 0b0000000) \
+	X(51, 'S','H',0,  0,  0,  0,  0,   TYPE_S,    0b0100011, 0b001, 0b0000000) \
+	X(52, 'S','L','L',0,  0,  0,  0,   TYPE_R,    0b0110011, 0b001, 0b0000000) \
+	X(53, 'S','L','L','I',0,  0,  0,   TYPE_I,    0b0010011, 0b001, 0b0000000) \
+	X(54, 'S','L','L','I','W',0,  0,   TYPE_I,    0b0011011, 0b001, 0b0000000) \
+	X(55, 'S','L','L','W',0,  0,  0,   TYPE_R,    0b0111011, 0b001, 0b0000000) \
+	X(56, 'S','L','T',0,  0,  0,  0,   TYPE_R,    0b0110011, 0b010, 0b0000000) \
+	X(57, 'S','L','T','I',0,  0,  0,   TYPE_I,    0b0010011, 0b010, 0b0000000) \
+	X(58, 'S','L','T','I','U',0,  0,   TYPE_I,    0b0010011, 0b011, 0b0000000) \
+	X(59, 'S','L','T','U',0,  0,  0,   TYPE_R,    0b0110011, 0b011, 0b0000000) \
+	X(60, 'S','R','A',0,  0,  0,  0,   TYPE_R,    0b0110011, 0b101, 0b0100000) \
+	X(61, 'S','R','A','I',0,  0,  0,   TYPE_I,    0b0010011, 0b101, 0b0000000) \
+	X(62, 'S','R','A','I','W',0,  0,   TYPE_I,    0b0011011, 0b101, 0b0000000) \
+	X(63, 'S','R','A','W',0,  0,  0,   TYPE_R,    0b0111011, 0b101, 0b0100000) \
+	X(64, 'S','R','L',0,  0,  0,  0,   TYPE_R,    0b0110011, 0b101, 0b0000000) \
+	X(65, 'S','R','L','I',0,  0,  0,   TYPE_I,    0b0010011, 0b101, 0b0000000) \
+	X(66, 'S','R','L','I','W',0,  0,   TYPE_I,    0b0011011, 0b101, 0b0000000) \
+	X(67, 'S','R','L','W',0,  0,  0,   TYPE_R,    0b0111011, 0b101, 0b0000000) \
+	X(68, 'S','U','B',0,  0,  0,  0,   TYPE_R,    0b0110011, 0b000, 0b0100000) \
+	X(69, 'S','U','B','W',0,  0,  0,   TYPE_R,    0b0111011, 0b000, 0b0100000) \
+	X(70, 'S','W',0,  0,  0,  0,  0,   TYPE_S,    0b0100011, 0b010, 0b0000000) \
+	X(71, 'X','O','R',0,  0,  0,  0,   TYPE_R,    0b0110011, 0b100, 0b0000000) \
+	X(72, 'X','O','R','I',0,  0,  0,   TYPE_I,    0b0010011, 0b100, 0b0000000)
+
+#define OP_INFO_ROW(id,a,b,c,d,e,f,g,type,op,fun3,fun7)	[id] = { type, op, fun3, fun7 },
+#define OP_KEY_ROW(id,a,b,c,d,e,f,g,type,op,fun3,fun7)		[id] = OP_KEY(a,b,c,d,e,f,g),
+#define OP_HASH_SLOT(id,a,b,c,d,e,f,g,type,op,fun3,fun7)	[OP_HASH(OP_KEY(a,b,c,d,e,f,g))] = id,
+#define OP_HASH_CASE(id,a,b,c,d,e,f,g,type,op,fun3,fun7)	case OP_HASH(OP_KEY(a,b,c,d,e,f,g)):
+
+static const _Alignas(64) Op_Info op_info[NUMBER_OF_OPS] =
 {
-	int i = 0;
-	while(const_name[i]!=0)
-	{
-		if(i>14)
-		{
-			// error
-			print_error("Error copy_op_name() ",-1);
-			exit(-1);
-		}
-		op_name->name[i] = 	const_name[i];
-		i++;
-	}
-	op_name->length = i;
-}
- 
-void init_instructions(Op_Name* op_name,Known_Prams* parms)
+	OP_TABLE(OP_INFO_ROW)
+};
+
+static const uint64_t op_key[NUMBER_OF_OPS] =
 {
-	int i = 1;
-	// ADD 	rd, rs1, rs2
-	// ID:
-	i = 1;
-	copy_op_name(&op_name[i],"ADD");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b000;			// fun3
-	parms[i].p_known[2] = 0b0000000;		// fun7
-	// ADDI rd, rs1, imm12
-	// ID:
-	i = 2;
-	copy_op_name(&op_name[i],"ADDI");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0010011;	// op
-	parms[i].p_known[1] = 0b000;			// fun3
-	// ADDIW rd, rs1, imm12
-	// ID:
-	i = 3;
-	copy_op_name(&op_name[i],"ADDIW");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0011011;		// op
-	parms[i].p_known[1] = 0b000;			// fun3
-	//ADDW rd, rs1, rs2
-	// ID:
-	i = 4;
-	copy_op_name(&op_name[i],"ADDW");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0111011;		// op
-	parms[i].p_known[1] = 0b000;			// fun3
-	parms[i].p_known[2] = 0b0000000;		// fun7
-	//AND rd, rs1, rs2
-	// ID:
-	i = 5;
-	copy_op_name(&op_name[i],"AND");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b111;			// fun3
-	parms[i].p_known[2] = 0b0000000;		// fun7
-	//ANDI rd, rs1, imm12
-	// ID:
-	i = 6;
-	copy_op_name(&op_name[i],"ANDI");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0010011;		// op
-	parms[i].p_known[1] = 0b111;			// fun3
-	//AUIPC rd, imm20
-	// ID:
-	i = 7;
-	copy_op_name(&op_name[i],"AUIPC");
-	parms[i].op_type = 	TYPE_U;
-	parms[i].p_known[0] = 0b0010111;		// op
-	//BEQ rs1, rs2, offset7
-	// ID:
-	i = 8;
-	copy_op_name(&op_name[i],"BEQ");
-	parms[i].op_type = 	TYPE_B;
-	parms[i].p_known[0] = 0b1100011;		// op
-	parms[i].p_known[1] = 0b000;			// fun3	
-	//BGE rs1, rs2, offset7
-	// ID:
-	i = 9;
-	copy_op_name(&op_name[i],"BGE");
-	parms[i].op_type = 	TYPE_B;
-	parms[i].p_known[0] = 0b1100011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3	
-	//BGEU rs1, rs2, offset7
-	// ID:
-	i = 10;
-	copy_op_name(&op_name[i],"BGEU");
-	parms[i].op_type = 	TYPE_B;
-	parms[i].p_known[0] = 0b1100011;		// op
-	parms[i].p_known[1] = 0b111;			// fun3	
-	//BLT rs1, rs2, offset7
-	// ID:
-	i = 11;
-	copy_op_name(&op_name[i],"BLT");
-	parms[i].op_type = 	TYPE_B;
-	parms[i].p_known[0] = 0b1100011;		// op
-	parms[i].p_known[1] = 0b100;			// fun3	
-	//BLTU rs1, rs2, offset7
-	// ID:
-	i = 12;
-	copy_op_name(&op_name[i],"BLTU");
-	parms[i].op_type = 	TYPE_B;
-	parms[i].p_known[0] = 0b1100011;		// op
-	parms[i].p_known[1] = 0b110;			// fun3	
-	//BNE rs1, rs2, offset7
-	// ID:
-	i = 13;
-	copy_op_name(&op_name[i],"BNE");
-	parms[i].op_type = 	TYPE_B;
-	parms[i].p_known[0] = 0b1100011;		// op
-	parms[i].p_known[1] = 0b001;			// fun3	
-	//CSRRC rd, rs1, imm12
-	// ID:
-	i = 14;
-	copy_op_name(&op_name[i],"CSRRC");	// TODO need to work on syntax on these
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b1110011;		// op
-	parms[i].p_known[1] = 0b011;			// fun3
-	//CSRRCI rd, rs1, imm12
-	// ID:
-	i = 15;
-	copy_op_name(&op_name[i],"CSRRCI");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b1110011;		// op
-	parms[i].p_known[1] = 0b111;			// fun3
-	//CSRRS rd, rs1, imm12
-	// ID:
-	i = 16;
-	copy_op_name(&op_name[i],"CSRRS");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b1110011;		// op
-	parms[i].p_known[1] = 0b010;			// fun3
-	//CSRRSI rd, rs1, imm12
-	// ID:
-	i = 17;
-	copy_op_name(&op_name[i],"CSRRSI");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b1110011;		// op
-	parms[i].p_known[1] = 0b110;			// fun3
-	//CSRRW rd, rs1, imm12
-	// ID:
-	i = 18;
-	copy_op_name(&op_name[i],"CSRRW");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b1110011;		// op
-	parms[i].p_known[1] = 0b001;			// fun3
-	//CSRRWI rd, rs1, imm12
-	// ID:
-	i = 19;
-	copy_op_name(&op_name[i],"CSRRWI");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b1110011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3
-	//DIV rd, rs1, rs2
-	// ID:
-	i = 20;
-	copy_op_name(&op_name[i],"DIV");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b100;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
-	//DIVU rd, rs1, rs2
-	// ID:
-	i = 21;
-	copy_op_name(&op_name[i],"DIVU");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
-	//DIVUW rd, rs1, rs2
-	// ID:
-	i = 22;
-	copy_op_name(&op_name[i],"DIVUW");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0111011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
-	//DIVW rd, rs1, rs2
-	// ID:
-	i = 23;
-	copy_op_name(&op_name[i],"DIVW");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0111011;		// op
-	parms[i].p_known[1] = 0b100;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
+	OP_TABLE(OP_KEY_ROW)
+};
 
-	// ---- Special
-	//EBREAK
-	// ID:
-	i = 24;
-	
-	//ECALL
-	// ID:
-	i = 25;
-	
-	//FENCE
-	// ID:
-	i = 26;
+static const uint8_t op_hash_table[256] =
+{
+	OP_TABLE(OP_HASH_SLOT)
+};
 
-	//FENCE.I
-	// ID:
-	i = 27;
-	
-	// ---- Special
-	
-	//JAL rd, offset20
-	// ID:
-	i = 28;
-	copy_op_name(&op_name[i],"JAL");
-	parms[i].op_type = 	TYPE_J;
-	parms[i].p_known[0] = 0b1101111;		// op	
-	//JALR rd, rs1, imm12
-	// ID:
-	i = 29;
-	copy_op_name(&op_name[i],"JALR");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b1100111;		// op
-	parms[i].p_known[1] = 0b000;			// fun3
-	//LB rd, rs1, imm12
-	// ID:
-	i = 30;
-	copy_op_name(&op_name[i],"LB");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0000011;		// op
-	parms[i].p_known[1] = 0b000;			// fun3
-	//LBU rd, rs1, imm12
-	// ID:
-	i = 31;
-	copy_op_name(&op_name[i],"LBU");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0000011;		// op
-	parms[i].p_known[1] = 0b100;			// fun3
-	//LD rd, rs1, imm12
-	// ID:
-	i = 32;
-	copy_op_name(&op_name[i],"LD");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0000011;		// op
-	parms[i].p_known[1] = 0b011;			// fun3
-	//LH rd, rs1, imm12
-	// ID:
-	i = 33;
-	copy_op_name(&op_name[i],"LH");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0000011;		// op
-	parms[i].p_known[1] = 0b001;			// fun3
-	//LHU rd, rs1, imm12
-	// ID:
-	i = 34;
-	copy_op_name(&op_name[i],"LHU");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0000011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3
-	//LUI rd, imm20
-	// ID:
-	i = 35;
-	copy_op_name(&op_name[i],"LUI");
-	parms[i].op_type = 	TYPE_U;
-	parms[i].p_known[0] = 0b0110111;		// op
-	//LW rd, rs1, imm12
-	// ID:
-	i = 36;
-	copy_op_name(&op_name[i],"LW");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0000011;		// op
-	parms[i].p_known[1] = 0b010;			// fun3
-	//LWU rd, rs1, imm12
-	// ID:
-	i = 37;
-	copy_op_name(&op_name[i],"LWU");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0000011;		// op
-	parms[i].p_known[1] = 0b110;			// fun3
-	//MUL rd, rs1, rs2
-	// ID:
-	i = 38;
-	copy_op_name(&op_name[i],"MUL");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b000;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
-	//MULH rd, rs1, rs2
-	// ID:
-	i = 39;
-	copy_op_name(&op_name[i],"MULH");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b001;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
-	//MULHSU rd, rs1, rs2
-	// ID:
-	i = 40;
-	copy_op_name(&op_name[i],"MULHSU");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;    	// op
-	parms[i].p_known[1] = 0b010;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
-	//MULHU rd, rs1, rs2
-	// ID:
-	i = 41;
-	copy_op_name(&op_name[i],"MULHU");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b011;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
-	//MULW rd, rs1, rs2
-	// ID:
-	i = 42;
-	copy_op_name(&op_name[i],"MULW");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0111011;		// op
-	parms[i].p_known[1] = 0b000;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
-	//OR rd, rs1, rs2
-	// ID:
-	i = 43;
-	copy_op_name(&op_name[i],"OR");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b110;			// fun3
-	parms[i].p_known[2] = 0b0000000;		// fun7
-	//ORI rd, rs1, imm12
-	// ID:
-	i = 44;
-	copy_op_name(&op_name[i],"ORI");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0010011;		// op
-	parms[i].p_known[1] = 0b110;			// fun3
-	//REM rd, rs1, rs2
-	// ID:
-	i = 45;
-	copy_op_name(&op_name[i],"REM");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b110;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
-	//REMU rd, rs1, rs2
-	// ID:
-	i = 46;
-	copy_op_name(&op_name[i],"REMU");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b111;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
-	//REMUW rd, rs1, rs2
-	// ID:
-	i = 47;
-	copy_op_name(&op_name[i],"REMUW");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0111011;		// op
-	parms[i].p_known[1] = 0b111;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
-	//REMW rd, rs1, rs2
-	// ID:
-	i = 48;
-	copy_op_name(&op_name[i],"REMW");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0111011;		// op
-	parms[i].p_known[1] = 0b110;			// fun3
-	parms[i].p_known[2] = 0b0000001;		// fun7
-	//SB rs2, rs1, offset7
-	// ID:
-	i = 49;
-	copy_op_name(&op_name[i],"SB");
-	parms[i].op_type = 	TYPE_S;
-	parms[i].p_known[0] = 0b0100011;		// op
-	parms[i].p_known[1] = 0b000;			// fun3		
-	//SD rs2, rs1, offset7
-	// ID:
-	i = 50;
-	copy_op_name(&op_name[i],"SD");
-	parms[i].op_type = 	TYPE_S;
-	parms[i].p_known[0] = 0b0100011;		// op
-	parms[i].p_known[1] = 0b011;			// fun3		
-	//SH rs2, rs1, offset7
-	// ID:
-	i = 51;
-	copy_op_name(&op_name[i],"SH");
-	parms[i].op_type = 	TYPE_S;
-	parms[i].p_known[0] = 0b0100011;		// op
-	parms[i].p_known[1] = 0b001;			// fun3		
-	//SLL rd, rs1, rs2
-	// ID:
-	i = 52;
-	copy_op_name(&op_name[i],"SLL");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b001;			// fun3
-	parms[i].p_known[2] = 0b0000000;		// fun7
-	//SLLI rd, rs1, imm12
-	// ID:
-	i = 53;
-	copy_op_name(&op_name[i],"SLLI");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0010011;		// op
-	parms[i].p_known[1] = 0b001;			// fun3
-	//SLLIW rd, rs1, imm12
-	// ID:
-	i = 54;
-	copy_op_name(&op_name[i],"SLLIW");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0011011;		// op
-	parms[i].p_known[1] = 0b001;			// fun3
-	//SLLW rd, rs1, rs2
-	// ID:
-	i = 55;
-	copy_op_name(&op_name[i],"SLLW");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0111011;		// op
-	parms[i].p_known[1] = 0b001;			// fun3
-	parms[i].p_known[2] = 0b0000000;		// fun7
-	//SLT rd, rs1, rs2
-	// ID:
-	i = 56;
-	copy_op_name(&op_name[i],"SLT");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b010;			// fun3
-	parms[i].p_known[2] = 0b0000000;		// fun7
-	//SLTI rd, rs1, imm12
-	// ID:
-	i = 57;
-	copy_op_name(&op_name[i],"SLTI");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0010011;		// op
-	parms[i].p_known[1] = 0b010;			// fun3
-	//SLTIU rd, rs1, imm12
-	// ID:
-	i = 58;
-	copy_op_name(&op_name[i],"SLTIU");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0010011;		// op
-	parms[i].p_known[1] = 0b011;			// fun3
-	//SLTU rd, rs1, rs2
-	// ID:
-	i = 59;
-	copy_op_name(&op_name[i],"SLTU");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b011;			// fun3
-	parms[i].p_known[2] = 0b0000000;		// fun7
-	//SRA rd, rs1, rs2
-	// ID:
-	i = 60;
-	copy_op_name(&op_name[i],"SRA");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3
-	parms[i].p_known[2] = 0b0100000;		// fun7
-	//SRAI rd, rs1, imm12
-	// ID:
-	i = 61;
-	copy_op_name(&op_name[i],"SRAI");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0010011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3
-	//SRAIW rd, rs1, imm12
-	// ID:
-	i = 62;
-	copy_op_name(&op_name[i],"SRAIW");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0011011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3
-	//SRAW rd, rs1, rs2
-	// ID:
-	i = 63;
-	copy_op_name(&op_name[i],"SRAW");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0111011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3
-	parms[i].p_known[2] = 0b0100000;		// fun7
-	//SRL rd, rs1, rs2
-	// ID:
-	i = 64;
-	copy_op_name(&op_name[i],"SRL");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3
-	parms[i].p_known[2] = 0b0000000;		// fun7
-	//SRLI rd, rs1, imm12
-	// ID:
-	i = 65;
-	copy_op_name(&op_name[i],"SRLI");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0010011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3
-	//SRLIW rd, rs1, imm12
-	// ID:
-	i = 66;
-	copy_op_name(&op_name[i],"SRLIW");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0011011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3
-	//SRLW rd, rs1, rs2
-	// ID:
-	i = 67;
-	copy_op_name(&op_name[i],"SRLW");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0111011;		// op
-	parms[i].p_known[1] = 0b101;			// fun3
-	parms[i].p_known[2] = 0b0000000;		// fun7
-	//SUB rd, rs1, rs2
-	// ID:
-	i = 68;
-	copy_op_name(&op_name[i],"SUB");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b000;			// fun3
-	parms[i].p_known[2] = 0b0100000;		// fun7
-	//SUBW rd, rs1, rs2
-	// ID:
-	i = 69;
-	copy_op_name(&op_name[i],"SUBW");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0111011;		// op
-	parms[i].p_known[1] = 0b000;			// fun3
-	parms[i].p_known[2] = 0b0100000;		// fun7
-	//SW rs2, rs1, offset7
-	// ID:
-	i = 70;
-	copy_op_name(&op_name[i],"SW");
-	parms[i].op_type = 	TYPE_S;
-	parms[i].p_known[0] = 0b0100011;		// op
-	parms[i].p_known[1] = 0b010;			// fun3		
-	//XOR rd, rs1, rs2
-	// ID:
-	i = 71;
-	copy_op_name(&op_name[i],"XOR");
-	parms[i].op_type = 	TYPE_R;
-	parms[i].p_known[0] = 0b0110011;		// op
-	parms[i].p_known[1] = 0b100;			// fun3
-	parms[i].p_known[2] = 0b0000000;		// fun7
-	//XORI rd, rs1, imm12	
-	// ID:
-	i = 72;
-	copy_op_name(&op_name[i],"XORI");
-	parms[i].op_type = 	TYPE_I;
-	parms[i].p_known[0] = 0b0010011;		// op
-	parms[i].p_known[1] = 0b100;			// fun3		
+// Never called, only here so a hash collision is a duplicate case error.
+static inline void op_hash_check(int slot)
+{
+	switch(slot)
+	{
+		OP_TABLE(OP_HASH_CASE)
+		default:
+			break;
+	}
 }
-
-#define		LETTER_A	65
-#define		LETTER_B	66
-#define		LETTER_C	67
-#define		LETTER_D	68
-#define		LETTER_E	69
-#define		LETTER_F	70
-#define		LETTER_J	74
-#define		LETTER_L	76
-#define		LETTER_M	77
-#define		LETTER_O	79
-#define		LETTER_R	82
-#define		LETTER_S	83
-#define		LETTER_X	88
-//#define		LETTER_
-//#define		LETTER_
-//#define		LETTER_
-//#define		LETTER_
-//#define		LETTER_
@@ -0,0 +1,160 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RING_H_
+#define RING_H_
+
+#include<stdint.h>
+#include<stdatomic.h>
+#include<pthread.h>
+
+// Lock free ring of pointers between one producer thread and one consumer.
+// head is only written by the producer and tail only by the consumer, each
+// on its own cache line. The store of head publishes the slot, the store of
+// tail hands it back.
+//
+// A side that finds the ring empty or full spins for a while, then sleeps
+// on moved until the other side moves its index. sleepers is raised before
+// the index is checked under lock and read after every index store, both
+// sequentially consistent, so either the sleeper sees the new index or the
+// other side sees the sleeper and signals it.
+
+#define RING_SIZE		16	// slots, a power of two
+#define RING_SPINS		64	// empty or full checks before the thread sleeps
+
+typedef struct Ring
+{
+	void*						slots[RING_SIZE];
+	_Alignas(64) atomic_uint	head;	// next slot to fill
+	_Alignas(64) atomic_uint	tail;	// next slot to take
+	_Alignas(64) atomic_int		sleepers;	// threads waiting on moved
+	pthread_mutex_t				lock;
+	pthread_cond_t				moved;
+}Ring;
+
+// 0 if the lock could not be made
+int ring_init(Ring *ring)
+{
+	atomic_init(&ring->head,0);
+	atomic_init(&ring->tail,0);
+	atomic_init(&ring->sleepers,0);
+	if( pthread_mutex_init(&ring->lock,NULL) != 0 )
+	{
+		return 0;
+	}
+	if( pthread_cond_init(&ring->moved,NULL) != 0 )
+	{
+		pthread_mutex_destroy(&ring->lock);
+		return 0;
+	}
+	return 1;
+}
+
+void ring_free(Ring *ring)
+{
+	pthread_cond_destroy(&ring->moved);
+	pthread_mutex_destroy(&ring->lock);
+}
+
+// wakes every thread sleeping on the ring, for a change it can not see in head or tail
+void ring_wake(Ring *ring)
+{
+	pthread_mutex_lock(&ring->lock);
+	pthread_cond_broadcast(&ring->moved);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+// after an index store, only takes the lock when a thread sleeps
+void ring_moved(Ring *ring)
+{
+	if( atomic_load(&ring->sleepers) != 0 )
+	{
+		ring_wake(ring);
+	}
+}
+
+// 0 if the ring is full
+int ring_push(Ring *ring,void *item)
+{
+	unsigned head = atomic_load_explicit(&ring->head,memory_order_relaxed);
+	if( head - atomic_load_explicit(&ring->tail,memory_order_acquire) == RING_SIZE )
+	{
+		return 0;
+	}
+	ring->slots[head & (RING_SIZE - 1)] = item;
+	atomic_store(&ring->head,head + 1);
+	ring_moved(ring);
+	return 1;
+}
+
+// NULL if the ring is empty
+void* ring_pop(Ring *ring)
+{
+	unsigned tail = atomic_load_explicit(&ring->tail,memory_order_relaxed);
+	if( atomic_load_explicit(&ring->head,memory_order_acquire) == tail )
+	{
+		return NULL;
+	}
+	void *item = ring->slots[tail & (RING_SIZE - 1)];
+	atomic_store(&ring->tail,tail + 1);
+	ring_moved(ring);
+	return item;
+}
+
+// waits while index is seen or until stop is set, stop may be NULL.
+// spins is the count of checks so far.
+void ring_wait(Ring *ring,atomic_uint *index,unsigned seen,atomic_int *stop,int *spins)
+{
+	if(++*spins < RING_SPINS)
+	{
+		return;
+	}
+	pthread_mutex_lock(&ring->lock);
+	atomic_fetch_add(&ring->sleepers,1);
+	while( (atomic_load(index) == seen) && ( (stop == NULL) || !atomic_load(stop) ) )
+	{
+		pthread_cond_wait(&ring->moved,&ring->lock);
+	}
+	atomic_fetch_sub(&ring->sleepers,1);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+// waits for an item, NULL once stop is set. stop may be NULL, a thread that
+// sets it calls ring_wake() after.
+void* ring_pop_wait(Ring *ring,atomic_int *stop)
+{
+	int spins = 0;
+	void *item = NULL;
+	while( ( (stop == NULL) || !atomic_load(stop) ) && ( (item = ring_pop(ring)) == NULL ) )
+	{
+		ring_wait(ring,&ring->head,atomic_load_explicit(&ring->tail,memory_order_relaxed),stop,&spins);
+	}
+	return item;
+}
+
+// waits for a free slot
+void ring_push_wait(Ring *ring,void *item)
+{
+	int spins = 0;
+	while( !ring_push(ring,item) )
+	{
+		ring_wait(ring,&ring->tail,atomic_load_explicit(&ring->head,memory_order_relaxed) - RING_SIZE,NULL,&spins);
+	}
+}
+
+#endif
@@ -0,0 +1,163 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCAN_H_
+#define SCAN_H_
+
+#include<stdint.h>
+#include<string.h>
+
+#include"chars.h"
+
+#if defined(__SSE2__)
+#include<emmintrin.h>
+#define SCAN_SSE2	1
+#endif
+
+// Source scanners, each returns a pointer to the first byte that does not
+// belong to the run, or end. With SSE2 they test 16 bytes at a time and
+// only ever read whole blocks that are inside the buffer, the tail is done
+// one byte at a time.
+
+#define SCAN_BLOCK	16
+
+#ifdef SCAN_SSE2
+// bytes from lo to hi, signed compare so bytes over 0x7f are never in range
+static inline __m128i scan_range(__m128i bytes,char lo,char hi)
+{
+	return _mm_and_si128( _mm_cmpgt_epi8(bytes,_mm_set1_epi8(lo - 1)),
+						  _mm_cmplt_epi8(bytes,_mm_set1_epi8(hi + 1)) );
+}
+
+// index of the first byte not set in match, SCAN_BLOCK if all are
+static inline int scan_first_miss(__m128i match)
+{
+	uint32_t miss = ~_mm_movemask_epi8(match) & 0xffff;
+	return miss ? __builtin_ctz(miss) : SCAN_BLOCK;
+}
+#endif
+
+// spaces and tabs
+static inline const uint8_t* scan_blank(const uint8_t *ptr,const uint8_t *end)
+{
+	// most calls find no blank or a single one, keep those off the vector path
+	if( (ptr < end) && !CHAR_IS(*ptr,CHAR_BLANK) )
+	{
+		return ptr;
+	}
+#ifdef SCAN_SSE2
+	while(end - ptr >= SCAN_BLOCK)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i*)ptr);
+		__m128i blank = _mm_or_si128( _mm_cmpeq_epi8(bytes,_mm_set1_epi8(' ')),
+									  _mm_cmpeq_epi8(bytes,_mm_set1_epi8('\t')) );
+		int n = scan_first_miss(blank);
+		ptr += n;
+		if(n < SCAN_BLOCK)
+		{
+			return ptr;
+		}
+	}
+#endif
+	while( (ptr < end) && CHAR_IS(*ptr,CHAR_BLANK) )
+	{
+		ptr++;
+	}
+	return ptr;
+}
+
+// the next line end, the C library memchr() is already vectorized
+static inline const uint8_t* scan_line_end(const uint8_t *ptr,const uint8_t *end)
+{
+	const uint8_t *line_end = memchr(ptr,'\n',end - ptr);
+	return line_end ? line_end : end;
+}
+
+// 0-9 A-Z a-z, the chars of label and const names
+static inline const uint8_t* scan_name(const uint8_t *ptr,const uint8_t *end)
+{
+#ifdef SCAN_SSE2
+	while(end - ptr >= SCAN_BLOCK)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i*)ptr);
+		__m128i folded = _mm_or_si128(bytes,_mm_set1_epi8(0x20));	// upper to lower case
+		__m128i name = _mm_or_si128( scan_range(bytes,'0','9'), scan_range(folded,'a','z') );
+		int n = scan_first_miss(name);
+		ptr += n;
+		if(n < SCAN_BLOCK)
+		{
+			return ptr;
+		}
+	}
+#endif
+	while( (ptr < end) && CHAR_IS(*ptr,CHAR_NAME) )
+	{
+		ptr++;
+	}
+	return ptr;
+}
+
+// 0-9 A-F a-f
+static inline const uint8_t* scan_hex(const uint8_t *ptr,const uint8_t *end)
+{
+#ifdef SCAN_SSE2
+	while(end - ptr >= SCAN_BLOCK)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i*)ptr);
+		__m128i folded = _mm_or_si128(bytes,_mm_set1_epi8(0x20));
+		__m128i hex = _mm_or_si128( scan_range(bytes,'0','9'), scan_range(folded,'a','f') );
+		int n = scan_first_miss(hex);
+		ptr += n;
+		if(n < SCAN_BLOCK)
+		{
+			return ptr;
+		}
+	}
+#endif
+	while( (ptr < end) && CHAR_IS(*ptr,CHAR_HEX) )
+	{
+		ptr++;
+	}
+	return ptr;
+}
+
+// . A-Z a-z, the chars of op names
+static inline const uint8_t* scan_op_name(const uint8_t *ptr,const uint8_t *end)
+{
+#ifdef SCAN_SSE2
+	while(end - ptr >= SCAN_BLOCK)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i*)ptr);
+		__m128i folded = _mm_or_si128(bytes,_mm_set1_epi8(0x20));
+		__m128i name = _mm_or_si128( _mm_cmpeq_epi8(bytes,_mm_set1_epi8('.')), scan_range(folded,'a','z') );
+		int n = scan_first_miss(name);
+		ptr += n;
+		if(n < SCAN_BLOCK)
+		{
+			return ptr;
+		}
+	}
+#endif
+	while( (ptr < end) && CHAR_IS(*ptr,CHAR_OP_NAME) )
+	{
+		ptr++;
+	}
+	return ptr;
+}
+
+#endif
@@ -0,0 +1,734 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SERVE_H_
+#define SERVE_H_
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<poll.h>
+#include<signal.h>
+#include<pthread.h>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<sys/stat.h>
+#include<sys/un.h>
+#include<sys/uio.h>
+
+#include"basm.h"
+#include"arena.h"
+
+// Daemon mode, basm_rv --serve socket_path [threads]
+// Listens on a Unix socket and assembles every source sent to it on one of
+// the worker threads. Each worker keeps a basm_session, so after the first
+// few requests a source is assembled with no allocation and no process start.
+// Open connections wait in one poll() loop on the main thread, a worker only
+// takes one when a request is on it and gives it back once it is answered, so
+// a client that keeps its connection open does not hold a worker.
+// A request may name the file its source came from. The daemon then keeps a
+// basm_cache for that path, so rebuilding an edited file only parses the
+// regions that changed, see basm_assemble_cached(). The path is only a name
+// for the cache, the daemon never opens it.
+// basm_connect() and basm_assemble_remote() are the client side, basm_rv
+// --client socket_path source binary uses them. A connection carries any
+// number of requests, each is
+//
+//	Serve_Request, then size bytes of source, then path_size bytes of path
+//
+// answered with
+//
+//	Serve_Reply, then size bytes of binary, or of error text if status is not 0,
+//	then messages_size bytes of warnings
+//
+// Both ends are on the same machine so the headers are in native byte order.
+// The socket is only open to the user that started the daemon.
+
+#define SERVE_MAGIC			0x6d736162	// "basm"
+#define SERVE_MAX_THREADS	256
+#define SERVE_BACKLOG		128		// connections waiting for accept()
+#define SERVE_MAX_SOURCE	(64*1024*1024)	// larger sources are refused before any memory is taken
+#define SERVE_KEEP_SOURCE	(1024*1024)		// a worker frees a source buffer grown past this after the request
+#define SERVE_SOCKET_UMASK	0177	// the socket is created rw for its owner only
+#define SERVE_MAX_CONNECTIONS	1024	// open connections, more are closed as they come
+#define SERVE_READ_TIMEOUT	10		// seconds a worker waits on a request that stopped coming
+#define SERVE_MAX_PATH		4096	// longer source paths are refused
+#define SERVE_MAX_CACHES	32		// sources with a cache, the one used longest ago is dropped for a new one
+#define SERVE_FLAGS			(BASM_COMPRESS | BASM_RELAX | BASM_RELAX_SCRATCH_MASK)	// flags a request may set
+
+typedef struct Serve_Request
+{
+	uint32_t	magic;
+	uint32_t	flags;
+	uint32_t	size;	// source bytes that follow
+	uint32_t	path_size;	// bytes of the source's path after it, 0 for no cache
+}Serve_Request;
+
+typedef struct Serve_Reply
+{
+	uint32_t	magic;
+	int32_t		status;		// 0 or -1 as returned by basm_assemble_session()
+	int32_t		error_line;
+	uint32_t	size;		// binary or error text bytes that follow
+	uint32_t	messages_size;	// warning text bytes after them, as a plain run prints it
+}Serve_Reply;
+
+// returns 0 if the connection failed
+int serve_write(int fd,const void *data,size_t size)
+{
+	const uint8_t *bytes = data;
+	while(size != 0)
+	{
+		ssize_t written = write(fd,bytes,size);
+		if(written < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			return 0;
+		}
+		bytes += written;
+		size -= written;
+	}
+	return 1;
+}
+
+// a header and what follows it in one call so the other end wakes up once,
+// returns 0 if the connection failed
+int serve_send(int fd,const void *header,size_t header_size,const void *data,size_t size)
+{
+	struct iovec parts[2] = { { (void*)header, header_size }, { (void*)data, size } };
+	ssize_t written;
+	do
+	{
+		written = writev(fd,parts,2);
+	}while( (written < 0) && (errno == EINTR) );
+	if(written < 0)
+	{
+		return 0;
+	}
+	if( (size_t)written < header_size )
+	{
+		return serve_write(fd,(const uint8_t*)header + written,header_size - written) && serve_write(fd,data,size);
+	}
+	return serve_write(fd,(const uint8_t*)data + (written - header_size),size - (written - header_size));
+}
+
+// returns 0 if the connection failed or was closed before size bytes came
+int serve_read(int fd,void *data,size_t size)
+{
+	uint8_t *bytes = data;
+	while(size != 0)
+	{
+		ssize_t got = read(fd,bytes,size);
+		if(got <= 0)
+		{
+			if( (got < 0) && (errno == EINTR) )
+			{
+				continue;
+			}
+			return 0;
+		}
+		bytes += got;
+		size -= got;
+	}
+	return 1;
+}
+
+// returns 0 if path does not fit in a socket address
+int serve_address(const char *path,struct sockaddr_un *address)
+{
+	memset(address,0,sizeof(struct sockaddr_un));
+	address->sun_family = AF_UNIX;
+	if( strlen(path) >= sizeof(address->sun_path) )
+	{
+		return 0;
+	}
+	strcpy(address->sun_path,path);
+	return 1;
+}
+
+int basm_connect(const char *socket_path)
+{
+	struct sockaddr_un address;
+	if( !serve_address(socket_path,&address) )
+	{
+		return -1;
+	}
+	int fd = socket(AF_UNIX,SOCK_STREAM,0);
+	if(fd < 0)
+	{
+		return -1;
+	}
+	if( connect(fd,(struct sockaddr*)&address,sizeof(address)) != 0 )
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// reads the warnings at the end of a reply into out->messages, or prints them
+// like a local run would without BASM_KEEP_MESSAGES. Returns 0 if the connection failed.
+int serve_messages(int connection,uint32_t size,int flags,basm_output *out)
+{
+	if(size == 0)
+	{
+		return 1;
+	}
+	char *messages = malloc((size_t)size + 1);
+	if( (messages == NULL) || !serve_read(connection,messages,size) )
+	{
+		free(messages);
+		return 0;
+	}
+	messages[size] = 0;
+	if(flags & BASM_KEEP_MESSAGES)
+	{
+		out->messages = messages;
+		return 1;
+	}
+	print_error(messages,-1);
+	free(messages);
+	return 1;
+}
+
+int basm_assemble_remote(int connection,const char *src,size_t len,int flags,basm_output *out)
+{
+	return basm_assemble_remote_cached(connection,NULL,src,len,flags,out);
+}
+
+int basm_assemble_remote_cached(int connection,const char *path,const char *src,size_t len,int flags,basm_output *out)
+{
+	out->data = NULL;
+	out->size = 0;
+	out->error_line = 0;
+	out->error[0] = 0;
+	out->messages = NULL;
+	size_t path_size = (path != NULL) ? strlen(path) : 0;
+	if( (len > SERVE_MAX_SOURCE) || (path_size > SERVE_MAX_PATH) )
+	{
+		snprintf(out->error,BASM_ERROR_SIZE,"%s",(len > SERVE_MAX_SOURCE) ? "Error Source too large for the daemon " : "Error Source path too long for the daemon ");
+		return -1;
+	}
+	Serve_Request request = { SERVE_MAGIC, flags & SERVE_FLAGS, (uint32_t)len, (uint32_t)path_size };
+	Serve_Reply reply;
+	if( !serve_send(connection,&request,sizeof(request),src,len) || !serve_write(connection,path,path_size) ||
+		!serve_read(connection,&reply,sizeof(reply)) || (reply.magic != SERVE_MAGIC) )
+	{
+		snprintf(out->error,BASM_ERROR_SIZE,"%s","\n Error talking to the daemon");
+		return -1;
+	}
+	if(reply.status != 0)
+	{
+		// error text longer than out->error is read and dropped
+		char error[BASM_ERROR_SIZE];
+		uint32_t left = reply.size;
+		uint32_t kept = (left < BASM_ERROR_SIZE) ? left : BASM_ERROR_SIZE - 1;
+		if( !serve_read(connection,out->error,kept) )
+		{
+			snprintf(out->error,BASM_ERROR_SIZE,"%s","\n Error talking to the daemon");
+			return -1;
+		}
+		out->error[kept] = 0;
+		for(left -= kept;left != 0;)
+		{
+			uint32_t part = (left < BASM_ERROR_SIZE) ? left : BASM_ERROR_SIZE;
+			if( !serve_read(connection,error,part) )
+			{
+				return -1;
+			}
+			left -= part;
+		}
+		out->error_line = reply.error_line;
+		serve_messages(connection,reply.messages_size,flags,out);
+		return -1;
+	}
+	out->data = malloc(reply.size ? reply.size : 1);
+	if(out->data == NULL)
+	{
+		snprintf(out->error,BASM_ERROR_SIZE,"%s","Error Out of memory ");
+		return -1;
+	}
+	if( !serve_read(connection,out->data,reply.size) || !serve_messages(connection,reply.messages_size,flags,out) )
+	{
+		basm_output_free(out);
+		snprintf(out->error,BASM_ERROR_SIZE,"%s","\n Error talking to the daemon");
+		return -1;
+	}
+	out->size = reply.size;
+	return 0;
+}
+
+// The cache of one source path, a worker marks it busy while it uses it
+typedef struct Serve_Cache
+{
+	char*			path;		// NULL for a free slot
+	basm_cache*		cache;
+	int				busy;
+	uint64_t		used;		// request number it was last used for
+}Serve_Cache;
+
+// Connections are in exactly one place at a time: idle in the poll loop,
+// ready for a worker, being answered, or returned to the poll loop.
+typedef struct Serve_Pool
+{
+	int				listen_fd;
+	int				wake[2];		// a worker writes a byte to wake[1] when it returns a connection
+	pthread_mutex_t	lock;
+	pthread_cond_t	has_ready;
+	int				ready[SERVE_MAX_CONNECTIONS];	// a request is waiting on these, first in first out
+	int				ready_first;
+	int				ready_count;
+	int				returned[SERVE_MAX_CONNECTIONS];	// answered, going back to the poll loop
+	int				returned_count;
+	int				open_count;
+	int				stop;
+	Serve_Cache		caches[SERVE_MAX_CACHES];
+	uint64_t		requests;
+}Serve_Pool;
+
+// the cache for path marked busy, NULL if there is none to spare. A path
+// another worker is using gets none, the request is assembled without it.
+Serve_Cache* serve_cache_take(Serve_Pool *pool,const char *path)
+{
+	Serve_Cache *found = NULL;
+	pthread_mutex_lock(&pool->lock);
+	pool->requests++;
+	for(int i=0;i<SERVE_MAX_CACHES;i++)
+	{
+		Serve_Cache *entry = &pool->caches[i];
+		if( (entry->path != NULL) && (strcmp(entry->path,path) == 0) )
+		{
+			found = entry->busy ? NULL : entry;
+			goto done;
+		}
+		if( !entry->busy && ( (found == NULL) || (entry->path == NULL) || ( (found->path != NULL) && (entry->used < found->used) ) ) )
+		{
+			found = entry; // a free slot, or the one used longest ago
+		}
+	}
+	if(found != NULL)
+	{
+		char *copy = malloc(strlen(path) + 1);
+		basm_cache *cache = (copy != NULL) ? basm_cache_new() : NULL;
+		if(cache == NULL)
+		{
+			free(copy);
+			found = NULL;
+			goto done;
+		}
+		free(found->path);
+		basm_cache_free(found->cache);
+		found->path = strcpy(copy,path);
+		found->cache = cache;
+	}
+done:
+	if(found != NULL)
+	{
+		found->busy = 1;
+		found->used = pool->requests;
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return found;
+}
+
+void serve_cache_give(Serve_Pool *pool,Serve_Cache *entry)
+{
+	pthread_mutex_lock(&pool->lock);
+	entry->busy = 0;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+// answers one request on fd, returns 0 if the connection is to be closed
+int serve_request(Serve_Pool *pool,basm_session *session,Arena *source,int fd)
+{
+	Serve_Request request;
+	char path[SERVE_MAX_PATH + 1];
+	if( !serve_read(fd,&request,sizeof(request)) || (request.magic != SERVE_MAGIC) )
+	{
+		return 0;
+	}
+	basm_output out;
+	Serve_Reply reply = { SERVE_MAGIC, -1, 0, 0, 0 };
+	arena_reset(source);
+	if( (request.size > SERVE_MAX_SOURCE) || (request.path_size > SERVE_MAX_PATH) || !arena_reserve(source,request.size) )
+	{
+		// the source can not be drained, answer and drop the connection
+		snprintf(out.error,BASM_ERROR_SIZE,"%s",(request.size > SERVE_MAX_SOURCE) ? "Error Source too large for the daemon " :
+			(request.path_size > SERVE_MAX_PATH) ? "Error Source path too long for the daemon " : "Error Out of memory ");
+		reply.size = strlen(out.error);
+		serve_send(fd,&reply,sizeof(reply),out.error,reply.size);
+		return 0;
+	}
+	if( !serve_read(fd,source->data,request.size) || !serve_read(fd,path,request.path_size) )
+	{
+		return 0;
+	}
+	path[request.path_size] = 0;
+	// the client's files are not the daemon's to read, $f is refused,
+	// and warnings go back to the client with the result
+	int flags = (request.flags & SERVE_FLAGS) | BASM_NO_DATA_FILES | BASM_KEEP_MESSAGES;
+	Serve_Cache *cached = NULL;
+	if( (request.path_size != 0) && !( flags & (BASM_COMPRESS | BASM_RELAX) ) )
+	{
+		cached = serve_cache_take(pool,path);
+	}
+	if(cached != NULL)
+	{
+		reply.status = basm_assemble_cached_flags(cached->cache,(const char*)source->data,request.size,flags,&out);
+		serve_cache_give(pool,cached);
+	}
+	else
+	{
+		reply.status = basm_assemble_session(session,(const char*)source->data,request.size,flags,&out);
+	}
+	const void *data = out.data;
+	if(reply.status != 0)
+	{
+		data = out.error;
+		reply.error_line = out.error_line;
+		reply.size = strlen(out.error);
+	}
+	else
+	{
+		reply.size = out.size;
+	}
+	reply.messages_size = (out.messages != NULL) ? strlen(out.messages) : 0;
+	int sent = serve_send(fd,&reply,sizeof(reply),data,reply.size) && serve_write(fd,out.messages,reply.messages_size);
+	if(cached != NULL)
+	{
+		// only a session's output stays with the session
+		basm_output_free(&out);
+	}
+	if(source->capacity > SERVE_KEEP_SOURCE)
+	{
+		// one big source must not hold its memory for the life of the daemon
+		arena_free(source);
+	}
+	return sent;
+}
+
+void* serve_worker(void *arg)
+{
+	Serve_Pool *pool = arg;
+	basm_session *session = basm_session_new();
+	Arena source = { NULL, 0, 0 };
+	if(session == NULL)
+	{
+		print_error("\n Error Out of memory ",-1);
+		return NULL;
+	}
+	while(1)
+	{
+		pthread_mutex_lock(&pool->lock);
+		while( (pool->ready_count == 0) && !pool->stop )
+		{
+			pthread_cond_wait(&pool->has_ready,&pool->lock);
+		}
+		if(pool->ready_count == 0)
+		{
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		int fd = pool->ready[pool->ready_first];
+		pool->ready_first = (pool->ready_first + 1) % SERVE_MAX_CONNECTIONS;
+		pool->ready_count--;
+		pthread_mutex_unlock(&pool->lock);
+
+		int keep = serve_request(pool,session,&source,fd);
+		pthread_mutex_lock(&pool->lock);
+		if(keep)
+		{
+			pool->returned[pool->returned_count++] = fd;
+		}
+		else
+		{
+			close(fd);
+			pool->open_count--;
+		}
+		pthread_mutex_unlock(&pool->lock);
+		if(keep)
+		{
+			while( (write(pool->wake[1],"",1) < 0) && (errno == EINTR) );
+		}
+	}
+	arena_free(&source);
+	basm_session_free(session);
+	return NULL;
+}
+
+// a new connection, blocking with SERVE_READ_TIMEOUT on reads so a request
+// that stops part way only holds its worker that long
+void serve_accept(Serve_Pool *pool,int *idle,int *idle_count)
+{
+	int fd = accept(pool->listen_fd,NULL,NULL);
+	if(fd < 0)
+	{
+		return; // the client gave up or the system is short of fds
+	}
+	pthread_mutex_lock(&pool->lock);
+	int full = (pool->open_count >= SERVE_MAX_CONNECTIONS);
+	pool->open_count += !full;
+	pthread_mutex_unlock(&pool->lock);
+	if(full)
+	{
+		close(fd);
+		return;
+	}
+	struct timeval timeout = { SERVE_READ_TIMEOUT, 0 };
+	fcntl(fd,F_SETFL,fcntl(fd,F_GETFL) & ~O_NONBLOCK);
+	setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(timeout));
+	idle[(*idle_count)++] = fd;
+}
+
+// waits on every idle connection and hands the ones with a request to the
+// workers, returns if poll() fails
+void serve_poll(Serve_Pool *pool)
+{
+	static struct pollfd fds[SERVE_MAX_CONNECTIONS + 2];
+	static int idle[SERVE_MAX_CONNECTIONS];
+	int idle_count = 0;
+	char drain[64];
+	while(1)
+	{
+		fds[0].fd = pool->wake[0];
+		fds[0].events = POLLIN;
+		fds[1].fd = pool->listen_fd;
+		fds[1].events = POLLIN;
+		for(int i=0;i<idle_count;i++)
+		{
+			fds[i + 2].fd = idle[i];
+			fds[i + 2].events = POLLIN;
+		}
+		if( poll(fds,idle_count + 2,-1) < 0 )
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+		// a request, or a close the worker will see, goes to a worker
+		int kept = 0;
+		pthread_mutex_lock(&pool->lock);
+		for(int i=0;i<idle_count;i++)
+		{
+			if(fds[i + 2].revents)
+			{
+				pool->ready[(pool->ready_first + pool->ready_count) % SERVE_MAX_CONNECTIONS] = idle[i];
+				pool->ready_count++;
+				pthread_cond_signal(&pool->has_ready);
+			}
+			else
+			{
+				idle[kept++] = idle[i];
+			}
+		}
+		idle_count = kept;
+		if(fds[0].revents)
+		{
+			while( read(pool->wake[0],drain,sizeof(drain)) > 0 );
+			for(int i=0;i<pool->returned_count;i++)
+			{
+				idle[idle_count++] = pool->returned[i];
+			}
+			pool->returned_count = 0;
+		}
+		pthread_mutex_unlock(&pool->lock);
+		if(fds[1].revents & POLLIN)
+		{
+			serve_accept(pool,idle,&idle_count);
+		}
+		else if(fds[1].revents)
+		{
+			break; // the socket is gone
+		}
+	}
+	for(int i=0;i<idle_count;i++)
+	{
+		close(idle[i]);
+	}
+}
+
+// returns only if the socket could not be set up or is closed
+int serve(const char *socket_path,int thread_count)
+{
+	struct sockaddr_un address;
+	if( !serve_address(socket_path,&address) )
+	{
+		print_error("\n Error socket path too long",-1);
+		return -1;
+	}
+	// a client that goes away while being answered must not end the daemon
+	signal(SIGPIPE,SIG_IGN);
+	int listen_fd = socket(AF_UNIX,SOCK_STREAM,0);
+	if(listen_fd < 0)
+	{
+		print_error("\n Error opening socket",-1);
+		return -1;
+	}
+	// only a socket left over from a daemon that was killed is removed
+	struct stat info;
+	if( lstat(socket_path,&info) == 0 )
+	{
+		if( !S_ISSOCK(info.st_mode) )
+		{
+			print_error("\n Error socket path is not a socket",-1);
+			close(listen_fd);
+			return -1;
+		}
+		int running = basm_connect(socket_path);
+		if(running >= 0)
+		{
+			print_error("\n Error a daemon is already serving on the socket",-1);
+			close(running);
+			close(listen_fd);
+			return -1;
+		}
+		unlink(socket_path);
+	}
+	// bind() creates the socket file, it is made rw for this user only
+	mode_t mask = umask(SERVE_SOCKET_UMASK);
+	int bound = bind(listen_fd,(struct sockaddr*)&address,sizeof(address));
+	umask(mask);
+	if( (bound != 0) || (listen(listen_fd,SERVE_BACKLOG) != 0) )
+	{
+		print_error("\n Error opening socket",-1);
+		close(listen_fd);
+		return -1;
+	}
+	printf("\n Serving on %s\n",socket_path);
+	fflush(stdout);
+
+	if(thread_count > SERVE_MAX_THREADS)
+	{
+		thread_count = SERVE_MAX_THREADS;
+	}
+	static Serve_Pool pool;
+	pool.listen_fd = listen_fd;
+	if( pipe(pool.wake) != 0 )
+	{
+		print_error("\n Error opening socket",-1);
+		close(listen_fd);
+		return -1;
+	}
+	// neither end may block the poll loop
+	fcntl(pool.wake[0],F_SETFL,O_NONBLOCK);
+	fcntl(listen_fd,F_SETFL,O_NONBLOCK);
+	pthread_mutex_init(&pool.lock,NULL);
+	pthread_cond_init(&pool.has_ready,NULL);
+	pthread_t threads[SERVE_MAX_THREADS];
+	int started = 0;
+	for(;started<thread_count;started++)
+	{
+		if( pthread_create(&threads[started],NULL,serve_worker,&pool) != 0 )
+		{
+			break;
+		}
+	}
+	if(started == 0)
+	{
+		print_error("\n Error starting worker threads",-1);
+	}
+	else
+	{
+		serve_poll(&pool);
+	}
+	pthread_mutex_lock(&pool.lock);
+	pool.stop = 1;
+	pthread_cond_broadcast(&pool.has_ready);
+	pthread_mutex_unlock(&pool.lock);
+	for(int i=0;i<started;i++)
+	{
+		pthread_join(threads[i],NULL);
+	}
+	for(int i=0;i<SERVE_MAX_CACHES;i++)
+	{
+		free(pool.caches[i].path);
+		basm_cache_free(pool.caches[i].cache);
+	}
+	pthread_mutex_destroy(&pool.lock);
+	pthread_cond_destroy(&pool.has_ready);
+	close(pool.wake[0]);
+	close(pool.wake[1]);
+	close(listen_fd);
+	return -1;
+}
+
+// basm_rv --client, one source sent to the daemon, "-" is stdin or stdout
+int serve_client(const char *socket_path,char *input_file,char *output_file,int flags)
+{
+	int connection = basm_connect(socket_path);
+	if(connection < 0)
+	{
+		print_error("\n Error no daemon on socket",-1);
+		return -1;
+	}
+	Source_File source;
+	int from_stdin = (strcmp(input_file,"-") == 0);
+	int to_stdout = (strcmp(output_file,"-") == 0);
+	if( from_stdin ? !read_source(stdin,&source) : !load_source(input_file,&source) )
+	{
+		print_error("\n Error opening file",-1);
+		close(connection);
+		return -1;
+	}
+	// a file is named by its full path so the daemon keeps one cache for it
+	// whatever directory it is built from
+	char *path = from_stdin ? NULL : realpath(input_file,NULL);
+	basm_output out;
+	int failed = basm_assemble_remote_cached(connection,path,(const char*)source.data,source.size,flags | BASM_KEEP_MESSAGES,&out);
+	free(path);
+	release_source(&source);
+	close(connection);
+	if(out.messages != NULL)
+	{
+		// the daemon's warnings, kept apart from the binary when it goes to stdout
+		fprintf(stderr,"%s",out.messages);
+		free(out.messages);
+		out.messages = NULL;
+	}
+	if(failed)
+	{
+		print_error(out.error,out.error_line - 1);
+		return -1;
+	}
+	FILE *output_file_ptr = to_stdout ? stdout : open_output(output_file);
+	if(output_file_ptr == NULL)
+	{
+		print_error("\n Error opening file",-1);
+		basm_output_free(&out);
+		return -1;
+	}
+	int written = put_code(output_file_ptr,out.data,out.size);
+	fclose(output_file_ptr);
+	basm_output_free(&out);
+	if(!written)
+	{
+		print_error("\n Error writing file",-1);
+		return -1;
+	}
+	return 0;
+}
+
+#endif
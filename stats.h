@@ -0,0 +1,68 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include<stdio.h>
+#include<time.h>
+
+#include"basm.h"
+
+// Timers and counters for --stats. With no basm_stats to fill in (ctx->stats
+// is NULL) each one is a single branch. Timers do not nest, one mark is kept.
+
+#define STATS_START(CTX)			do{ if((CTX)->stats){ (CTX)->stats_mark = stats_now(); } }while(0)
+#define STATS_END(CTX,FIELD)		do{ if((CTX)->stats){ (CTX)->stats->FIELD += stats_now() - (CTX)->stats_mark; } }while(0)
+#define STATS_COUNT(CTX,FIELD,N)	do{ if((CTX)->stats){ (CTX)->stats->FIELD += (N); } }while(0)
+
+// seconds from some fixed point
+double stats_now(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// one JSON object on one line, times in milliseconds
+void basm_stats_json(const basm_stats *stats,FILE *file)
+{
+	fprintf(file,"{\"time_ms\":{\"total\":%.3f,\"tokenize\":%.3f,\"op_lookup\":%.3f,\"labels\":%.3f,\"encode\":%.3f,\"fixups\":%.3f,\"write\":%.3f},",
+		stats->total_time * 1e3,
+		stats->tokenize_time * 1e3,
+		stats->op_lookup_time * 1e3,
+		stats->label_time * 1e3,
+		stats->encode_time * 1e3,
+		stats->fixup_time * 1e3,
+		stats->write_time * 1e3);
+	fprintf(file,"\"lines\":%llu,\"instructions\":%llu,\"labels\":%llu,\"consts\":%llu,\"forward_refs\":%llu,\"label_probes\":%llu,\"const_steps\":%llu,\"bytes_written\":%llu}\n",
+		(unsigned long long)stats->lines,
+		(unsigned long long)stats->instructions,
+		(unsigned long long)stats->labels,
+		(unsigned long long)stats->consts,
+		(unsigned long long)stats->forward_refs,
+		(unsigned long long)stats->label_probes,
+		(unsigned long long)stats->const_steps,
+		(unsigned long long)stats->bytes_written);
+}
+
+#endif
@@ -0,0 +1,118 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Checks basm_assemble_cached() against basm_assemble(), run by make check.
+//
+//	cache source.s ...
+//
+// The sources are assembled in order through one basm_cache, so each one
+// after the first takes the regions it shares with the one before from the
+// cache. The binary, the error and every message printed must be the same
+// as a plain assembly of that source. Prints a FAIL line for each that is not.
+
+#include"../basm_rv.c"
+
+typedef struct Cache_Run
+{
+	int				status;
+	basm_output		out;
+	char*			messages;	// everything print_error() wrote
+	long			message_size;
+}Cache_Run;
+
+// runs cached or plain with the messages sent to a temporary file
+int cache_run(basm_cache *cache,const Source_File *source,Cache_Run *run)
+{
+	message_file = tmpfile();
+	if(message_file == NULL)
+	{
+		return FALSE;
+	}
+	if(cache != NULL)
+	{
+		run->status = basm_assemble_cached(cache,(const char*)source->data,source->size,&run->out);
+	}
+	else
+	{
+		run->status = basm_assemble((const char*)source->data,source->size,&run->out);
+	}
+	run->message_size = ftell(message_file);
+	run->messages = malloc(run->message_size + 1);
+	rewind(message_file);
+	if( (run->messages == NULL) || (fread(run->messages,1,run->message_size,message_file) != (size_t)run->message_size) )
+	{
+		fclose(message_file);
+		message_file = NULL;
+		return FALSE;
+	}
+	run->messages[run->message_size] = 0;
+	fclose(message_file);
+	message_file = NULL;
+	return TRUE;
+}
+
+void cache_run_free(Cache_Run *run)
+{
+	basm_output_free(&run->out);
+	free(run->messages);
+}
+
+int main(int argc,char *argv[])
+{
+	basm_cache *cache = basm_cache_new();
+	int failed = (cache == NULL);
+	for(int i=1;i<argc;i++)
+	{
+		Source_File source;
+		if( !load_source(argv[i],&source) )
+		{
+			printf("FAIL cache: can not read %s\n",argv[i]);
+			failed = TRUE;
+			continue;
+		}
+		Cache_Run cached = {0};
+		Cache_Run plain = {0};
+		if( !cache_run(cache,&source,&cached) || !cache_run(NULL,&source,&plain) )
+		{
+			printf("FAIL cache: %s could not be run\n",argv[i]);
+			failed = TRUE;
+		}
+		else if( (cached.status != plain.status) || (cached.out.size != plain.out.size) ||
+			( (cached.out.size != 0) && (memcmp(cached.out.data,plain.out.data,plain.out.size) != 0) ) )
+		{
+			printf("FAIL cache: %s binary differs from a plain assembly\n",argv[i]);
+			failed = TRUE;
+		}
+		else if( (strcmp(cached.out.error,plain.out.error) != 0) || (cached.out.error_line != plain.out.error_line) )
+		{
+			printf("FAIL cache: %s error \"%s\" line %d, plain \"%s\" line %d\n",argv[i],
+				cached.out.error,cached.out.error_line,plain.out.error,plain.out.error_line);
+			failed = TRUE;
+		}
+		else if( strcmp(cached.messages,plain.messages) != 0 )
+		{
+			printf("FAIL cache: %s messages differ from a plain assembly:\n%s---\n%s\n",argv[i],cached.messages,plain.messages);
+			failed = TRUE;
+		}
+		cache_run_free(&cached);
+		cache_run_free(&plain);
+		release_source(&source);
+	}
+	basm_cache_free(cache);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,19 @@
+# const expressions, folded at 64 bits and checked to fit 32 bits where used
+@sum [1 + 2 << 3]
+@or [f0 | f & 3c]
+@top [1 << 3f]
+@sign [@top >> 3f]
+@back [(1 << 20) >> 1c]
+@neg [-(-5) - - 2]
+@wide [123456789abcdef0]
+@high [@wide >> 20]
+@low [@wide & ffffffff]
+@mask [(1 << a) - 1]
+addi	x5, x0, @mask
+addi	x6, x0, @neg
+$ @sum
+$ @or
+$ @sign
+$ @back
+$ @high
+$ @low
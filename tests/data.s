@@ -0,0 +1,10 @@
+# data lines, each padded with zeros to a multiple of 4 bytes
+$b [de ad beef 00112233]
+$b [01, 02 03]
+$h [1234, -1 7]
+$h [-8000]
+$w [deadbeef 1 -2]
+$w [ffffffff,0]
+$f [data.raw]
+$ [cafef00d]
+addi	x1, x0, 1
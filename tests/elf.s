@@ -0,0 +1,13 @@
+# ELF output, --elf leaves far and outside to the linker
+@step [10]
+
+:start:
+addi	x1, x0, @step
+beq	x1, x0, >outside
+jal	x1, >far
+bne	x1, x2, >done
+jal	x0, >start
+:done:
+jalr	x0, x1, 0
+:table:
+$w [1 2 3]
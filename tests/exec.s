@@ -0,0 +1,10 @@
+# --elf-exec, every label is in the source
+:start:
+addi	x1, x0, 5
+:loop:
+addi	x1, x1, -1
+bne	x1, x0, >loop
+jal	x2, >done
+$w [deadbeef 12345678]
+:done:
+jal	x0, >start
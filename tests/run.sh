@@ -0,0 +1,330 @@
+#!/bin/sh
+#    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+#    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# Regression checks, make check runs them.
+#
+#	run.sh basm_rv out_dir
+#
+# out_dir also holds the library checks built by make check.
+#
+# A check assembles a source in tests/, or one made here, and compares the output with the bytes
+# in tests/ref/, kept as od -An -tx1 output, or with the same source assembled
+# another way. The ref bytes were checked against llvm-objdump when they were
+# written. REF_UPDATE=1 writes the refs again from the current build.
+
+BASM=$1
+OUT=$2
+DIR=$(dirname "$0")
+failed=0
+
+fail()
+{
+	echo "FAIL $*"
+	failed=1
+}
+
+# assemble name source [options], FALSE and a FAIL line if it did not assemble
+assemble()
+{
+	name=$1
+	source=$2
+	shift 2
+	if ! "$BASM" "$@" "$source" "$OUT/$name.bin" > "$OUT/$name.msg" 2>&1; then
+		fail "$name: $(cat "$OUT/$name.msg")"
+		return 1
+	fi
+	return 0
+}
+
+# ref name source [options], the output is tests/ref/name.hex
+ref()
+{
+	name=$1
+	assemble "$@" || return
+	if [ -n "$REF_UPDATE" ]; then
+		od -An -tx1 "$OUT/$name.bin" > "$DIR/ref/$name.hex"
+	fi
+	od -An -tx1 "$OUT/$name.bin" | cmp -s - "$DIR/ref/$name.hex" || fail "$name: differs from ref/$name.hex"
+}
+
+# error name source message [options], fails with message in its output
+error()
+{
+	name=$1
+	source=$2
+	message=$3
+	shift 3
+	if "$BASM" "$@" "$source" "$OUT/$name.bin" > "$OUT/$name.msg" 2>&1; then
+		fail "$name: assembled, expected \"$message\""
+		return
+	fi
+	grep -q -- "$message" "$OUT/$name.msg" || fail "$name: expected \"$message\", got: $(cat "$OUT/$name.msg")"
+}
+
+# same name source input [options], source assembled with options, read from
+# stdin when input is -, must give the binary and messages of a plain assembly
+same()
+{
+	name=$1
+	source=$2
+	input=$3
+	shift 3
+	"$BASM" "$source" "$OUT/$name.plain.bin" > "$OUT/$name.plain.msg" 2>&1
+	if [ "$input" = - ]; then
+		"$BASM" "$@" - "$OUT/$name.bin" < "$source" > "$OUT/$name.msg" 2>&1
+	else
+		"$BASM" "$@" "$source" "$OUT/$name.bin" > "$OUT/$name.msg" 2>&1
+	fi
+	cmp -s "$OUT/$name.plain.bin" "$OUT/$name.bin" || fail "$name: binary differs from a plain assembly"
+	cmp -s "$OUT/$name.plain.msg" "$OUT/$name.msg" || fail "$name: messages differ from a plain assembly: $(cat "$OUT/$name.msg")"
+}
+
+# client name source [options], assembled by the daemon on $SOCKET must give the
+# binary, messages and exit status of a plain assembly, a failed one leaves no binary to compare
+client()
+{
+	name=$1
+	source=$2
+	shift 2
+	"$BASM" "$@" "$source" "$OUT/$name.plain.bin" > "$OUT/$name.plain.msg" 2>&1
+	plain=$?
+	"$BASM" --client "$SOCKET" "$@" "$source" "$OUT/$name.bin" > "$OUT/$name.msg" 2>&1
+	status=$?
+	[ $status = $plain ] || fail "$name: exit status $status, plain $plain"
+	if [ $plain = 0 ]; then
+		cmp -s "$OUT/$name.plain.bin" "$OUT/$name.bin" || fail "$name: binary differs from a plain assembly"
+	fi
+	cmp -s "$OUT/$name.plain.msg" "$OUT/$name.msg" || fail "$name: messages differ from a plain assembly: $(cat "$OUT/$name.msg")"
+}
+
+# fill count, count ops that do not use a label and have no 16 bit form
+fill()
+{
+	awk -v count="$1" 'BEGIN { for(i = 0; i < count; i++) print "addi x3, x4, 1" }'
+}
+
+mkdir -p "$OUT"
+
+# ELF, relocatable with relocations for missing labels and no .data, and executable
+ref elf_rel "$DIR/elf.s" --elf
+ref elf_exec "$DIR/exec.s" --elf-exec
+
+# RVC, ops with a 16 bit form and the branches and jumps that reach their label in one
+ref rvc "$DIR/rvc.s" -c
+
+# --relax, each branch and jump in the smallest form that reaches its label
+{
+	echo ":top:"
+	echo "beq x8, x0, >near"
+	echo "beq x1, x2, >far"
+	echo "jal x0, >far"
+	echo ":near:"
+	fill 1100
+	echo ":far:"
+	echo "bne x1, x2, >top"
+	echo "jal x1, >top"
+} > "$OUT/relax.s"
+ref relax "$OUT/relax.s" --relax
+ref relax_rvc "$OUT/relax.s" --relax -c
+
+# past the 1 MiB reach of a JAL only a named scratch register gets a branch or an x0 jump there
+{
+	echo "addi x1, x1, 1"
+	echo "beq x1, x2, >end"
+	echo "jal x1, >end"
+	fill 270000
+	echo ":end:"
+	echo "jal x0, >start"
+	echo ":start:"
+} > "$OUT/relax_far.s"
+error relax_far "$OUT/relax_far.s" "Offset out of scope without a relax scratch register  - on line 2" --relax
+ref relax_scratch "$OUT/relax_far.s" --relax-scratch x7
+{
+	echo "jal x0, >end"
+	fill 270000
+	echo ":end:"
+} > "$OUT/relax_far_jump.s"
+error relax_far_jump "$OUT/relax_far_jump.s" "Offset out of scope without a relax scratch register  - on line 1" --relax
+
+# --stats counts ops as they are written, 16 bit ones and not data lines
+{
+	echo "addi x8, x8, 1"
+	echo "add x1, x2, x3"
+	echo "\$w [1 2 3 4]"
+	echo "\$b [11 22]"
+} > "$OUT/stats.s"
+assemble stats "$OUT/stats.s" -c --stats && { grep -q '"instructions":2,' "$OUT/stats.msg" || fail "stats: expected 2 instructions, got: $(cat "$OUT/stats.msg")"; }
+
+# -j, a source named .bin is not written over and every message line starts with its source
+mkdir -p "$OUT/batch"
+cp "$DIR/exec.s" "$OUT/batch/exec.s"
+cp "$DIR/exec.s" "$OUT/batch/code.bin"
+{
+	echo "beq x1, x2, >far"
+	fill 1100
+	echo ":far:"
+} > "$OUT/batch/far.s"
+"$BASM" -j 3 "$OUT/batch/exec.s" "$OUT/batch/code.bin" "$OUT/batch/far.s" > "$OUT/batch.msg" 2>&1 || fail "batch: $(cat "$OUT/batch.msg")"
+"$BASM" "$DIR/exec.s" "$OUT/batch_plain.bin" > /dev/null 2>&1
+cmp -s "$DIR/exec.s" "$OUT/batch/code.bin" || fail "batch: the source code.bin was written over"
+cmp -s "$OUT/batch_plain.bin" "$OUT/batch/code.bin.bin" || fail "batch: code.bin.bin differs from a plain assembly"
+cmp -s "$OUT/batch_plain.bin" "$OUT/batch/exec.bin" || fail "batch: exec.bin differs from a plain assembly"
+grep -v "^\$" "$OUT/batch.msg" | grep -q -v "^ $OUT/batch/[a-z.]*: " && fail "batch: a message without its source: $(cat "$OUT/batch.msg")"
+grep -A1 "far.s: Error Offset out of scope - on line 1103" "$OUT/batch.msg" | grep -q "far.s: Assembled with no Errors" || fail "batch: far.s warning missing or apart: $(cat "$OUT/batch.msg")"
+
+# const expressions, precedence, 64 bit shifts and the 32 bit check where a const is used
+ref const "$DIR/const.s"
+{
+	echo "@wide [123456789]"
+	echo "\$ @wide"
+} > "$OUT/const_wide.s"
+error const_wide "$OUT/const_wide.s" "Const does not fit in 32 bits  - on line 2"
+awk 'BEGIN {
+	printf "@deep ["
+	for(i = 0; i < 40; i++) printf "-"
+	print "1]"
+}' > "$OUT/const_deep.s"
+error const_deep "$OUT/const_deep.s" "Const expression too deep  - on line 1"
+
+# the region cache, rebuilt after edits and with warnings from regions it keeps
+cache_source()
+{
+	awk -v step="$1" -v edit="$2" 'BEGIN {
+		print "@step [" step "]"
+		for(i = 0; i < 600; i++)
+		{
+			print ":lab" i ":"
+			print (i == edit) ? "addi x1, x1, 7" : "addi x1, x1, @step"
+			print "beq x1, x2, >lab" (i + 1)
+			if(i == 300)
+			{
+				for(n = 0; n < 1100; n++) print "addi x3, x4, 1"
+				print "beq x1, x2, >lab290"
+			}
+		}
+		print ":lab600:"
+		print "bne x1, x2, >lab599"
+	}'
+}
+cache_source 4 -1 > "$OUT/cache_a.s"
+{ echo "addi x9, x9, 1"; cat "$OUT/cache_a.s"; } > "$OUT/cache_moved.s"
+cache_source 4 450 > "$OUT/cache_edited.s"
+sed '200s/.*/addi x1, x1/' "$OUT/cache_a.s" > "$OUT/cache_broken.s"
+cache_source 8 -1 > "$OUT/cache_const.s"
+"$OUT/cache" "$OUT/cache_a.s" "$OUT/cache_a.s" "$OUT/cache_moved.s" "$OUT/cache_edited.s" \
+	"$OUT/cache_broken.s" "$OUT/cache_a.s" "$OUT/cache_const.s" || failed=1
+
+# streamed from stdin and pipelined, several read blocks with forward
+# references across them, and ops out of range that must not hold the output back
+awk 'BEGIN {
+	for(i = 0; i < 40000; i++)
+	{
+		print ":s" i ":"
+		print "beq x1, x2, >s" (i + 1)
+		print "jal x0, >s" (i + 5)
+		print "addi x3, x4, 1"
+		if(i % 10000 == 0)
+		{
+			print "bne x1, x2, >s" (i + 400)
+		}
+	}
+	for(; i < 40005; i++) print ":s" i ":"
+}' > "$OUT/stream.s"
+same stream "$OUT/stream.s" -
+same stream_pipeline "$OUT/stream.s" - --pipeline
+same stream_pipeline_file "$OUT/stream.s" "$OUT/stream.s" --pipeline
+same stream_relax_source "$OUT/relax.s" -
+
+# a label that never comes may hold the streamed output back 1 MiB at most
+{
+	echo "addi x1, x1, 1"
+	echo "jal x0, >nowhere"
+	fill 300000
+} > "$OUT/stream_missing.s"
+error stream_missing "$OUT/stream_missing.s" "Label out of reach of a streamed op  - on line 2" --pipeline
+
+# $b $h $w lists, commas, negatives, padding and a $f file, little endian on any host
+ref data "$DIR/data.s"
+echo "\$b [abc]" > "$OUT/data_odd.s"
+error data_odd "$OUT/data_odd.s" "Bytes need two hex digits  - on line 1"
+echo "\$h [12345]" > "$OUT/data_long.s"
+error data_long "$OUT/data_long.s" "Number is too long - on line 1"
+
+# a relative $f path is read from the directory of the source, not the current one
+printf 'raw' > "$OUT/data_raw.bin"
+{
+	echo "addi x1, x1, 1"
+	echo "\$f [data_raw.bin]"
+} > "$OUT/data_file.s"
+assemble data_file "$OUT/data_file.s" && { od -An -tx1 "$OUT/data_file.bin" | grep -q "72 61 77 00" || fail "data_file: the file is not in the output"; }
+same data_file_threads "$OUT/data_file.s" "$OUT/data_file.s" -t 4
+
+# the daemon, warnings come back to the client with the result
+SOCKET=$OUT/serve.sock
+rm -f "$SOCKET" "$OUT/serve.bin"
+"$BASM" --serve "$SOCKET" 2 > "$OUT/serve.msg" 2>&1 &
+daemon=$!
+trap 'kill $daemon 2> /dev/null' EXIT
+tries=0
+while [ ! -S "$SOCKET" ] && [ $tries -lt 50 ]; do
+	sleep 0.1
+	tries=$((tries + 1))
+done
+if [ ! -S "$SOCKET" ]; then
+	fail "serve: no socket, $(cat "$OUT/serve.msg")"
+else
+	case $(ls -l "$SOCKET") in
+		srw-------*) ;;
+		*) fail "serve: socket is not rw for its owner only: $(ls -l "$SOCKET")" ;;
+	esac
+	client client "$DIR/exec.s"
+	client client_rvc "$DIR/rvc.s" -c
+	client client_relax "$OUT/relax.s" --relax
+	client client_scratch "$OUT/relax_far.s" --relax-scratch x7
+	client client_error "$OUT/cache_broken.s"
+	client client_warning "$OUT/batch/far.s"
+	# one file edited between --client runs, the daemon keeps its regions
+	for step in a a edited moved broken a const; do
+		cp "$OUT/cache_$step.s" "$OUT/client_cache.s"
+		client "client_cache_$step" "$OUT/client_cache.s"
+	done
+	# the daemon does not read files for its clients
+	if "$BASM" --client "$SOCKET" "$OUT/data_file.s" "$OUT/client_data_file.bin" > "$OUT/client_data_file.msg" 2>&1; then
+		fail "client_data_file: the daemon read a \$f file"
+	fi
+	grep -q "not allowed here  - on line 2" "$OUT/client_data_file.msg" || fail "client_data_file: $(cat "$OUT/client_data_file.msg")"
+	"$OUT/serve" "$SOCKET" || failed=1
+	if "$BASM" --serve "$SOCKET" 1 > "$OUT/serve_running.msg" 2>&1; then
+		fail "serve_running: a second daemon started on the socket"
+	fi
+	grep -q "already serving" "$OUT/serve_running.msg" || fail "serve_running: $(cat "$OUT/serve_running.msg")"
+fi
+kill $daemon 2> /dev/null
+wait $daemon 2> /dev/null
+
+# --serve never removes a path that is not a socket
+echo keep > "$OUT/serve.file"
+if "$BASM" --serve "$OUT/serve.file" 1 > "$OUT/serve_file.msg" 2>&1; then
+	fail "serve_file: served on a regular file"
+fi
+grep -q "not a socket" "$OUT/serve_file.msg" || fail "serve_file: $(cat "$OUT/serve_file.msg")"
+[ "$(cat "$OUT/serve.file")" = keep ] || fail "serve_file: the file was changed"
+
+if [ $failed = 0 ]; then
+	echo "All checks passed"
+fi
+exit $failed
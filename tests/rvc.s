@@ -0,0 +1,23 @@
+# -c, each op here has a 16 bit form except the last three
+:start:
+addi	x8, x0, 5
+addi	x8, x8, -3
+addi	x2, x2, -20
+addi	x9, x2, 10
+add	x10, x0, x11
+add	x10, x10, x11
+sub	x8, x8, x9
+and	x8, x8, x9
+slli	x10, x10, 3
+srli	x8, x8, 2
+andi	x8, x8, 7
+lui	x5, 1f
+lw	x9, x8, 8
+sd	x9, x2, 10
+ld	x10, x2, 10
+beq	x8, x0, >start
+jalr	x0, x1, 0
+jal	x0, >start
+addi	x8, x8, 320
+beq	x8, x9, >start
+jal	x1, >start
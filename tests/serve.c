@@ -0,0 +1,112 @@
+/*
+    basm_rv - A very simple Risc-V RV64 assembler for building flat binaries, done in a single pass.
+    Copyright (C) 2022  Ben Olmstead <myos.sos.os.ben@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Checks that a daemon started with --serve refuses a request over
+// SERVE_MAX_SOURCE before reading it and keeps serving, and that clients
+// keeping their connections open do not hold its workers, run by make check.
+//
+//	serve socket_path
+//
+// Prints a FAIL line and exits 1 if it does not.
+
+#include"../basm_rv.c"
+
+#define SERVE_CHECK_SOURCE	"addi x1, x0, 5\n"
+#define SERVE_CHECK_IDLE	8	// connections left open, more than the daemon has workers
+#define SERVE_CHECK_TIMEOUT	10	// seconds before a daemon that stopped answering is a failure
+
+void serve_check_timeout(int signal_number)
+{
+	(void)signal_number;
+	static const char message[] = "FAIL serve: the daemon stopped answering\n";
+	ssize_t written = write(STDOUT_FILENO,message,sizeof(message) - 1);
+	(void)written;
+	_exit(1);
+}
+
+int main(int argc,char *argv[])
+{
+	if(argc != 2)
+	{
+		printf("FAIL serve: usage serve socket_path\n");
+		return 1;
+	}
+	int connection = basm_connect(argv[1]);
+	if(connection < 0)
+	{
+		printf("FAIL serve: no daemon on %s\n",argv[1]);
+		return 1;
+	}
+	// only the header is sent, the daemon must answer without waiting for the source
+	Serve_Request request = { SERVE_MAGIC, 0, SERVE_MAX_SOURCE + 1, 0 };
+	Serve_Reply reply;
+	char error[BASM_ERROR_SIZE] = {0};
+	if( !serve_write(connection,&request,sizeof(request)) || !serve_read(connection,&reply,sizeof(reply)) ||
+		(reply.magic != SERVE_MAGIC) || (reply.size >= BASM_ERROR_SIZE) || !serve_read(connection,error,reply.size) )
+	{
+		printf("FAIL serve: no answer to a request over SERVE_MAX_SOURCE\n");
+		close(connection);
+		return 1;
+	}
+	close(connection);
+	if( (reply.status == 0) || (strstr(error,"too large") == NULL) )
+	{
+		printf("FAIL serve: a request over SERVE_MAX_SOURCE got status %d \"%s\"\n",reply.status,error);
+		return 1;
+	}
+
+	// the client side refuses it too, without sending
+	basm_output out;
+	connection = basm_connect(argv[1]);
+	if( (connection < 0) || (basm_assemble_remote(connection,SERVE_CHECK_SOURCE,(size_t)SERVE_MAX_SOURCE + 1,0,&out) == 0) )
+	{
+		printf("FAIL serve: basm_assemble_remote() sent a source over SERVE_MAX_SOURCE\n");
+		return 1;
+	}
+
+	// the same connection still works, nothing was sent on it
+	if( (basm_assemble_remote(connection,SERVE_CHECK_SOURCE,strlen(SERVE_CHECK_SOURCE),0,&out) != 0) || (out.size != OP_CODE_SIZE) )
+	{
+		printf("FAIL serve: the daemon stopped serving after a refused request: %s\n",out.error);
+		close(connection);
+		return 1;
+	}
+	basm_output_free(&out);
+	close(connection);
+
+	// each connection is used once and left open, the last one must still be answered
+	signal(SIGALRM,serve_check_timeout);
+	alarm(SERVE_CHECK_TIMEOUT);
+	int idle[SERVE_CHECK_IDLE];
+	for(int i=0;i<SERVE_CHECK_IDLE;i++)
+	{
+		idle[i] = basm_connect(argv[1]);
+		if( (idle[i] < 0) || (basm_assemble_remote(idle[i],SERVE_CHECK_SOURCE,strlen(SERVE_CHECK_SOURCE),0,&out) != 0) )
+		{
+			printf("FAIL serve: connection %d of %d with the others left open was not answered\n",i + 1,SERVE_CHECK_IDLE);
+			return 1;
+		}
+		basm_output_free(&out);
+	}
+	for(int i=0;i<SERVE_CHECK_IDLE;i++)
+	{
+		close(idle[i]);
+	}
+	alarm(0);
+	return 0;
+}